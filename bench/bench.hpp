@@ -0,0 +1,133 @@
+#pragma once
+
+// what the benchmark targets share: key=value options, the failure count, timing and the json they print
+//
+// a target parses fuzz=, ms= and sizes= here and its own keys through a callback,
+// fuzzes first and counts every mismatch in failures, then times and prints
+// { header fields..., "results": [ { row }, ... ] } to stdout
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+struct bench_options
+{
+    size_t fuzz = 200;
+    size_t ms = 200;
+    std::vector<size_t> sizes;
+};
+
+// atomic so fuzz threads can count too
+inline std::atomic<size_t> failures = 0;
+
+// results are written here so the timed work is not optimized away
+inline volatile double sink = 0;
+
+// a comma separated list of sizes, each at least 1
+inline std::vector<size_t> parse_sizes(std::string const& value)
+{
+    std::vector<size_t> sizes;
+    std::stringstream ss(value);
+    for (std::string s; std::getline(ss, s, ',');)
+        sizes.push_back(std::max<size_t>(1, std::stoul(s)));
+    return sizes;
+}
+
+// fills opt from the arguments, extra(key, value) takes the keys of one target and returns false for unknown ones
+template<class Extra>
+void parse(int argc, char** argv, bench_options& opt, Extra&& extra)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq), value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if ("fuzz" == key)
+            opt.fuzz = std::stoul(value);
+        else if ("ms" == key)
+            opt.ms = std::max<size_t>(1, std::stoul(value));
+        else if ("sizes" == key)
+            opt.sizes = parse_sizes(value);
+        else if (!extra(key, value))
+            std::cerr << "ignoring unknown argument " << arg << "\n";
+    }
+}
+
+inline void parse(int argc, char** argv, bench_options& opt)
+{
+    parse(argc, argv, opt, [](std::string const&, std::string const&) { return false; });
+}
+
+// mean time of f over at least opt.ms milliseconds, at least one run
+template<class F>
+double ns_per_run(F&& f, bench_options const& opt)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::milliseconds(opt.ms);
+    size_t rounds = 0;
+    do
+    {
+        f();
+        ++rounds;
+    } while (std::chrono::steady_clock::now() < end);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / double(rounds);
+}
+
+// a json name and value, strings are quoted and a value that was not measured is null
+struct json_field
+{
+    char const* name;
+    std::string value;
+
+    json_field(char const* name, char const* s) : name(name), value(std::string("\"") + s + "\"") {}
+
+    template<class T> requires std::is_arithmetic_v<T>
+    json_field(char const* name, T v) : name(name)
+    {
+        std::ostringstream os;
+        os << v;
+        value = os.str();
+    }
+
+    template<class T>
+    json_field(char const* name, std::optional<T> v) : json_field(v ? json_field(name, *v) : json_field(name)) {}
+
+private:
+    explicit json_field(char const* name) : name(name), value("null") {}
+};
+
+inline void print_header(std::initializer_list<json_field> fields)
+{
+    std::cout << "{\n";
+    for (auto const& f : fields)
+        std::cout << "  \"" << f.name << "\": " << f.value << ",\n";
+    std::cout << "  \"failures\": " << failures << ",\n";
+    std::cout << "  \"results\": [";
+}
+
+// one element of the results array, first is cleared after it
+inline void print_result(bool& first, std::initializer_list<json_field> fields)
+{
+    std::cout << (first ? "\n" : ",\n") << "    {";
+    const char* separator = " ";
+    for (auto const& f : fields)
+    {
+        std::cout << separator << "\"" << f.name << "\": " << f.value;
+        separator = ", ";
+    }
+    std::cout << " }";
+    first = false;
+}
+
+inline void print_footer()
+{
+    std::cout << "\n  ]\n}\n";
+}
@@ -0,0 +1,73 @@
+// compile time checks of the constant evaluated mat, polynomial and complex arithmetic
+//
+// every static_assert runs its operation in a constant expression, so a helper on these paths that stops being
+// constexpr, or a kernel that is no longer skipped during constant evaluation, fails this translation unit
+// instead of quietly moving the work to run time. nothing here runs, the target only has to compile
+
+#include <polynomial.hpp>
+
+using namespace er;
+
+namespace
+{
+
+template<class T>
+constexpr bool near(T x, T y, T tolerance)
+{
+    return abs(x - y) <= tolerance;
+}
+
+template<class T, int N>
+constexpr bool is_identity(mat<T, N, N> const& m, T tolerance)
+{
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            if (!near(m(i, j), i == j ? T(1) : T(0), tolerance))
+                return false;
+    return true;
+}
+
+// generic loops
+constexpr mat<f64, 3, 3> a(2, 0, 1, 1, 3, 0, 0, 1, 4);
+static_assert(25 == determinant(a));
+static_assert(1 == transpose(a)(0, 1) && 0 == transpose(a)(1, 0) && 1 == transpose(a)(2, 0));
+static_assert(4 == (a * a)(0, 0) && 6 == (a * a)(0, 2) && 16 == (a * a)(2, 2));
+static_assert(3 == (a + a - a * 2.0 + a)(1, 1) && 8 == (2.0 * a)(2, 2) && 0.5 == (a / 4.0)(0, 0));
+static_assert(is_identity(inverse(a) * a, 1e-12));
+static_assert(near(lu_factorization<f64, 3>(a).solve(col_vec<f64, 3>(3, 4, 5))(0, 0), 1.0, 1e-12));
+
+// the sse and avx kernel shapes, which have to step aside during constant evaluation
+constexpr mat<f32, 4, 4> b(4, 1, 0, 0, 1, 4, 1, 0, 0, 1, 4, 1, 0, 0, 1, 4);
+static_assert(near(determinant(b), 209.0f, 1e-3f));
+static_assert(17 == (b * b)(0, 0) && 8 == (b * b)(0, 1) && 1 == transpose(b)(3, 2));
+static_assert(is_identity(inverse(b) * b, 1e-5f));
+static_assert(6 == (row_vec<f32, 4>(1, 1, 1, 1) * b)(0, 1));
+
+constexpr mat<f64, 4, 4> c(2, 0, 0, 1, 0, 3, 0, 0, 0, 0, 4, 0, 1, 0, 0, 5);
+static_assert(near(determinant(c), 108.0, 1e-12) && is_identity(c * inverse(c), 1e-12));
+
+// the division free determinant and characteristic polynomial of integral T
+constexpr mat<i64, 5, 5> d(2, 1, 0, 0, 0, 1, 2, 1, 0, 0, 0, 1, 2, 1, 0, 0, 0, 1, 2, 1, 0, 0, 0, 1, 2);
+static_assert(6 == determinant(d));
+static_assert(-6 == characteristic_polynomial(d).data[0] && -10 == characteristic_polynomial(d).data[4] && 1 == characteristic_polynomial(d).data[5]);
+static_assert(near(characteristic_polynomial(a).data[0], -25.0, 1e-12) && near(characteristic_polynomial(a).data[2], -9.0, 1e-12));
+
+// 1 + 2x + 3x^2 and x - 1
+constexpr polynomial<i64, 2> p(1, 2, 3);
+constexpr polynomial<i64, 1> q(-1, 1);
+static_assert(17 == p(2) && 1 == q(2));
+static_assert(17 == (p * q)(2) && 3 == (p * q).data[3] && -1 == (p * q).data[0]);
+static_assert(8 == derivative(p)(1) && 6 == derivative(derivative(p))(5));
+static_assert(18 == (p + q)(2) && 16 == (p - q)(2) && -17 == (-p)(2));
+
+constexpr complex<f64> z(1, 2), w(3, -1);
+static_assert(z * w == complex<f64>(5, 5) && z + w == complex<f64>(4, 1) && z - w == complex<f64>(-2, 3));
+static_assert(5 == magsq(z) && ~z == complex<f64>(1, -2) && -z == complex<f64>(-1, -2));
+static_assert(near((z / w).x, 0.1, 1e-15) && near((z / w).y, 0.7, 1e-15));
+static_assert(z * 2.0 == complex<f64>(2, 4) && complex<f64>(2, 4) / 2.0 == z);
+
+// quaternions, i j = k and j i = -k
+constexpr complex<f64, 1> i(0, 1, 0, 0), j(0, 0, 1, 0), k(0, 0, 0, 1);
+static_assert(i * j == k && j * i == -k && i * i == complex<f64, 1>(-1, 0, 0, 0));
+
+}
@@ -0,0 +1,187 @@
+// differential fuzzing and throughput of er::least_squares, the qr and the cholesky factorizations
+//
+// q r must give back the matrix with orthonormal q, least squares residuals must be orthogonal to the columns,
+// cholesky must solve spd systems and reject indefinite ones, for mat and dyn_mat; then least squares by qr is
+// timed against the normal equations with cholesky, with the error of both on a polynomial fit whose coefficients
+// are known; results go to stdout as json
+//
+// usage: eigenray_least_squares_bench [fuzz=cases] [ms=time per measurement] [sizes=64,128,...]
+
+#include "bench.hpp"
+
+#include <least_squares.hpp>
+
+#include <random>
+
+using namespace er;
+
+double uniform(std::mt19937_64& gen) { return std::uniform_real_distribution<double>(-1, 1)(gen); }
+
+template<class T>
+dyn_mat<T> random_dyn_mat(std::mt19937_64& gen, size_t rows, size_t cols)
+{
+    dyn_mat<T> m(rows, cols);
+    for (auto& x : m.data)
+        x = T(uniform(gen));
+    return m;
+}
+
+template<class T>
+double max_abs(dyn_mat<T> const& m)
+{
+    double worst = 0;
+    for (auto const& x : m.data)
+        worst = std::max(worst, std::abs(double(x)));
+    return worst;
+}
+
+void check(bool ok, char const* what, char const* type, size_t rows, size_t cols, double e = 0)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cerr << what << " for " << type << " " << rows << "x" << cols << ", error " << e << "\n";
+    }
+}
+
+// the fixed size factorizations against the run time sized ones on the same matrices
+template<class T, int R, int C>
+void fuzz_fixed(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    mat<T, R, C> a;
+    mat<T, R, 2> b;
+    for (int i = 0; i < R; ++i)
+    {
+        for (int j = 0; j < C; ++j)
+            a(i, j) = T(uniform(gen));
+        for (int j = 0; j < 2; ++j)
+            b(i, j) = T(uniform(gen));
+    }
+    const qr_factorization<T, R, C> qr(a);
+    const auto x = least_squares(a, b);
+    const auto ref = least_squares(dyn_mat<T>(a), dyn_mat<T>(b));
+    const double e = max_abs(dyn_mat<T>(qr.q() * qr.r()) - dyn_mat<T>(a)), d = max_abs(dyn_mat<T>(x) - ref);
+    check(e <= tolerance, "fixed qr", type, R, C, e);
+    check(d <= tolerance * 1e3 * (1 + max_abs(ref)), "fixed least squares", type, R, C, d);
+
+    const auto spd = transpose(a) * a + mat<T, C, C>::identity();
+    const cholesky_factorization<T, C> ch(spd);
+    const auto y = ch.solve(transpose(a) * b);
+    const double r = max_abs(dyn_mat<T>(spd * y - transpose(a) * b));
+    check(!ch.indefinite && r <= tolerance * 1e2, "fixed cholesky", type, C, C, r);
+    check(cholesky_factorization<T, C>(-spd).indefinite, "fixed indefinite", type, C, C);
+}
+
+// random shapes across the block boundaries, |q^T q - I|, |q r - a| and |a^T (a x - b)| relative to |a|^2 |x|
+template<class T>
+void fuzz_dyn(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    const size_t rows = gen() % 300 + 1, cols = gen() % 300 + 1, k = gen() % 3 + 1;
+    const auto a = random_dyn_mat<T>(gen, rows, cols);
+    const dyn_qr_factorization<T> qr(a);
+    const auto q = qr.q();
+    const double n = double(std::max(rows, cols));
+    const double orth = max_abs(transpose(q) * q - dyn_mat<T>::identity(q.cols)), e = max_abs(q * qr.r() - a);
+    check(orth <= tolerance * n && e <= tolerance * n, "dyn qr", type, rows, cols, std::max(orth, e));
+
+    if (rows >= cols)
+    {
+        const auto b = random_dyn_mat<T>(gen, rows, k);
+        const auto x = least_squares(a, b);
+        const double r = max_abs(transpose(a) * (a * x - b)) / (1 + max_abs(x));
+        check(!qr.rank_deficient && r <= tolerance * n * n, "dyn least squares", type, rows, cols, r);
+    }
+
+    const auto spd = transpose(a) * a + dyn_mat<T>::identity(cols);
+    const dyn_cholesky_factorization<T> ch(spd);
+    const auto b = random_dyn_mat<T>(gen, cols, k);
+    const double r = max_abs(spd * ch.solve(b) - b) / (1 + max_abs(spd));
+    check(!ch.indefinite && r <= tolerance * n, "dyn cholesky", type, cols, cols, r);
+    check(dyn_cholesky_factorization<T>(-spd).indefinite, "dyn indefinite", type, cols, cols);
+}
+
+// the random systems have no known solution and the ill conditioned fit is not timed, what was not measured is null
+void print(bool& first, char const* op, char const* path, size_t rows, size_t cols, std::optional<double> ns, std::optional<double> error)
+{
+    print_result(first, { { "op", op }, { "path", path }, { "rows", rows }, { "cols", cols }, { "ns", ns }, { "coefficient_error", error } });
+}
+
+// a degree C - 1 polynomial through R points on [0, 1] with coefficients all 1, as fitting code forms it by hand
+template<class A, class B>
+void vandermonde(A& a, B& b, size_t rows, size_t cols)
+{
+    for (size_t i = 0; i < rows; ++i)
+    {
+        const double t = double(i) / double(rows - 1);
+        double p = 1, s = 0;
+        for (size_t j = 0; j < cols; ++j, p *= t)
+        {
+            a(i, j) = p;
+            s += p;
+        }
+        b(i, 0) = s;
+    }
+}
+
+template<class M>
+double coefficient_error(M const& x, size_t cols)
+{
+    double worst = 0;
+    for (size_t j = 0; j < cols; ++j)
+        worst = std::max(worst, std::abs(double(x(j, 0)) - 1));
+    return worst;
+}
+
+void time_fixed(bool& first, bench_options const& opt)
+{
+    constexpr int R = 32, C = 6;
+    mat<f64, R, C> a;
+    mat<f64, R, 1> b;
+    vandermonde(a, b, R, C);
+    print(first, "fit", "qr", R, C, ns_per_run([&] { sink = sink + least_squares(a, b)(0, 0); }, opt), coefficient_error(least_squares(a, b), C));
+    auto normal = [&] { return cholesky_factorization<f64, C>(transpose(a) * a).solve(transpose(a) * b); };
+    print(first, "fit", "normal_equations", R, C, ns_per_run([&] { sink = sink + normal()(0, 0); }, opt), coefficient_error(normal(), C));
+}
+
+void time_dyn(std::mt19937_64& gen, bool& first, bench_options const& opt)
+{
+    for (size_t n : opt.sizes)
+    {
+        const size_t rows = 4 * n;
+        const auto a = random_dyn_mat<f64>(gen, rows, n), b = random_dyn_mat<f64>(gen, rows, 1);
+        print(first, "random", "qr", rows, n, ns_per_run([&] { sink = sink + least_squares(a, b)(0, 0); }, opt), std::nullopt);
+        auto normal = [&] { const auto at = transpose(a); return dyn_cholesky_factorization<f64>(at * a).solve(at * b); };
+        print(first, "random", "normal_equations", rows, n, ns_per_run([&] { sink = sink + normal()(0, 0); }, opt), std::nullopt);
+    }
+
+    // ill conditioned enough that squaring the condition costs the normal equations most of their digits
+    const size_t rows = 200, cols = 10;
+    dyn_mat<f64> a(rows, cols), b(rows, 1);
+    vandermonde(a, b, rows, cols);
+    const auto at = transpose(a);
+    print(first, "fit", "qr", rows, cols, std::nullopt, coefficient_error(least_squares(a, b), cols));
+    print(first, "fit", "normal_equations", rows, cols, std::nullopt, coefficient_error(dyn_cholesky_factorization<f64>(at * a).solve(at * b), cols));
+}
+
+int main(int argc, char** argv)
+{
+    bench_options opt{ .fuzz = 100, .sizes = { 64, 128, 256, 512 } };
+    parse(argc, argv, opt);
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+    {
+        fuzz_fixed<f64, 6, 3>(gen, "f64", 1e-14);
+        fuzz_fixed<f64, 5, 5>(gen, "f64", 1e-14);
+        fuzz_fixed<f32, 8, 4>(gen, "f32", 1e-5);
+        fuzz_dyn<f64>(gen, "f64", 1e-15);
+    }
+
+    print_header({ { "fuzz_cases", 4 * opt.fuzz } });
+    bool first = true;
+    time_fixed(first, opt);
+    time_dyn(gen, first, opt);
+    print_footer();
+
+    return failures ? 1 : 0;
+}
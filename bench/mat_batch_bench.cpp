@@ -0,0 +1,172 @@
+// differential fuzzing and throughput of er::mat_batch against per matrix er::mat
+//
+// every lane of multiply, determinant, inverse and solve is checked against mat to a relative tolerance,
+// with some lanes made singular or in need of a row swap, then batch and scalar throughput are timed;
+// results go to stdout as json
+//
+// usage: eigenray_mat_batch_bench [count=matrices per measurement] [fuzz=batches] [ms=time per measurement]
+
+#include "bench.hpp"
+
+#include <mat_batch.hpp>
+
+#include <random>
+
+using namespace er;
+
+struct options : bench_options
+{
+    size_t count = 4096;
+};
+
+template<class T, int R, int C>
+mat<T, R, C> random_mat(std::mt19937_64& gen)
+{
+    mat<T, R, C> m;
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            m.raw_data[i][j] = T(std::uniform_real_distribution<double>(-1, 1)(gen));
+    return m;
+}
+
+template<class T, int R, int C>
+double difference(mat<T, R, C> const& x, mat<T, R, C> const& y)
+{
+    double worst = 0;
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            worst = std::max(worst, std::abs(double(x.raw_data[i][j]) - double(y.raw_data[i][j])));
+    return worst;
+}
+
+void check(bool ok, char const* op, char const* type, int n)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cerr << op << " mismatch for " << type << " " << n << "x" << n << "\n";
+    }
+}
+
+// inverses and solutions are compared relative to the condition estimate |m| |m^-1|, so near singular lanes pass
+template<class T, int N>
+void fuzz(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    constexpr int L = detail::batch_width<T>;
+    mat<T, N, N> a[L], b[L];
+    mat<T, N, 2> rhs[L];
+    for (int l = 0; l < L; ++l)
+    {
+        a[l] = random_mat<T, N, N>(gen);
+        b[l] = random_mat<T, N, N>(gen);
+        rhs[l] = random_mat<T, N, 2>(gen);
+        if (gen() % 4 == 0)
+            a[l].raw_data[0][0] = T(0);
+        // exactly singular, a dependent row would leave rounding noise that either path may call singular
+        if (gen() % 8 == 0)
+            for (int j = 0; j < N; ++j)
+                a[l].raw_data[N - 1][j] = T(0);
+    }
+
+    const int count = int(gen() % L) + 1;
+    const mat_batch<T, N, N, L> ba(a, count), bb(b, count);
+    const mat_batch<T, N, 2, L> brhs(rhs, count);
+
+    const auto prod = ba * bb;
+    const auto det = determinant(ba);
+    const auto inv = inverse(ba);
+    const auto x = solve(ba, brhs);
+    const mat_batch_lu<T, N, L> lu(ba);
+
+    for (int l = 0; l < count; ++l)
+    {
+        check(difference(prod.get(l), a[l] * b[l]) <= tolerance * N, "mul", type, N);
+        const double d = double(determinant(a[l]));
+        check(std::abs(double(det[l]) - d) <= tolerance * N, "determinant", type, N);
+
+        if (lu.singular[l])
+        {
+            check(difference(inv.get(l), mat<T, N, N>{}) == 0 && difference(x.get(l), mat<T, N, 2>{}) == 0, "singular", type, N);
+            continue;
+        }
+        const auto ref = inverse(a[l]);
+        const double cond = N * (1 + difference(ref, mat<T, N, N>{})) * (1 + difference(a[l], mat<T, N, N>{}));
+        check(difference(inv.get(l), ref) <= tolerance * cond * cond, "inverse", type, N);
+        check(difference(a[l] * x.get(l), rhs[l]) <= tolerance * cond, "solve", type, N);
+    }
+    // lanes past count are padded with the identity
+    for (int l = count; l < L; ++l)
+        check(difference(inv.get(l), mat<T, N, N>::identity()) == 0, "padding", type, N);
+}
+
+// matrices per second of the batch and of mat one at a time, on the same count matrices
+template<class T, int N>
+void time_size(std::mt19937_64& gen, char const* type, options const& opt, bool& first)
+{
+    constexpr int L = detail::batch_width<T>;
+    const size_t batches = (opt.count + L - 1) / L, count = batches * L;
+
+    std::vector<mat<T, N, N>> a(count), b(count), r(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        a[i] = random_mat<T, N, N>(gen);
+        b[i] = random_mat<T, N, N>(gen);
+    }
+    std::vector<mat_batch<T, N, N, L>> ba, bb, br(batches);
+    for (size_t k = 0; k < batches; ++k)
+    {
+        ba.emplace_back(a.data() + k * L);
+        bb.emplace_back(b.data() + k * L);
+    }
+
+    auto scalar = [&](auto&& f) { return ns_per_run([&] { for (size_t i = 0; i < count; ++i) f(i); }, opt); };
+    auto batch = [&](auto&& f) { return ns_per_run([&] { for (size_t k = 0; k < batches; ++k) f(k); }, opt); };
+
+    struct result { char const* op; char const* path; double ns; };
+    const result results[] = {
+        { "mul", "scalar", scalar([&](size_t i) { r[i] = a[i] * b[i]; }) },
+        { "mul", "batch", batch([&](size_t k) { br[k] = ba[k] * bb[k]; }) },
+        { "determinant", "scalar", scalar([&](size_t i) { sink = sink + double(determinant(a[i])); }) },
+        { "determinant", "batch", batch([&](size_t k) { sink = sink + double(determinant(ba[k])[0]); }) },
+        { "inverse", "scalar", scalar([&](size_t i) { r[i] = inverse(a[i]); }) },
+        { "inverse", "batch", batch([&](size_t k) { br[k] = inverse(ba[k]); }) },
+        { "solve", "scalar", scalar([&](size_t i) { r[i] = lu_factorization<T, N>(a[i]).solve(b[i]); }) },
+        { "solve", "batch", batch([&](size_t k) { br[k] = solve(ba[k], bb[k]); }) },
+        // the store back to an array of mat included
+        { "convert", "batch", batch([&](size_t k) { mat_batch<T, N, N, L>(a.data() + k * L).store(r.data() + k * L); }) },
+    };
+
+    for (auto const& [op, path, ns] : results)
+        print_result(first, { { "op", op }, { "path", path }, { "type", type }, { "n", N }, { "matrices_per_s", double(count) / ns * 1e9 } });
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    parse(argc, argv, opt, [&](std::string const& key, std::string const& value)
+    {
+        if ("count" == key)
+            opt.count = std::max<size_t>(1, std::stoul(value));
+        return "count" == key;
+    });
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+    {
+        fuzz<f32, 2>(gen, "f32", 1e-5);
+        fuzz<f32, 3>(gen, "f32", 1e-5);
+        fuzz<f32, 4>(gen, "f32", 1e-5);
+        fuzz<f64, 4>(gen, "f64", 1e-12);
+        fuzz<f64, 6>(gen, "f64", 1e-12);
+    }
+
+    print_header({ { "f32_lanes", detail::batch_width<f32> }, { "f64_lanes", detail::batch_width<f64> }, { "count", opt.count },
+        { "fuzz_batches", 5 * opt.fuzz } });
+    bool first = true;
+    time_size<f32, 3>(gen, "f32", opt, first);
+    time_size<f32, 4>(gen, "f32", opt, first);
+    time_size<f64, 4>(gen, "f64", opt, first);
+    print_footer();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,429 @@
+// differential fuzzing and throughput of er::dyn_mat
+//
+// gemm is checked against the naive triple loop on random shapes, exactly for integers
+// and to a relative tolerance for floats, lu solves and eigenpairs by their residual,
+// the sse and avx kernels of the small float mat against the generic loops on the same values in long double,
+// lazy mat expressions, reductions and assignments that read their destination against the eager operators,
+// characteristic_polynomial up to 8x8 through berkowitz on i64 against the hessenberg recurrence, the determinant and the trace,
+// then gemm, the naive loop, lu, its solve and eigen are timed per size; results go to stdout as json
+//
+// usage: eigenray_mat_bench [fuzz=cases] [ms=time per measurement] [sizes=64,128,...] [naive_max=largest naive size]
+//                           [eigen_max=largest eigen size]
+
+#include "bench.hpp"
+
+#include <eigen.hpp>
+#include <mat_expr.hpp>
+#include <polynomial.hpp>
+
+#include <cmath>
+#include <random>
+#include <tuple>
+
+using namespace er;
+
+struct options : bench_options
+{
+    size_t naive_max = 512;
+    size_t eigen_max = 512;
+};
+
+template<class T>
+dyn_mat<T> random_mat(std::mt19937_64& gen, size_t rows, size_t cols)
+{
+    dyn_mat<T> m(rows, cols);
+    for (auto& x : m.data)
+    {
+        if constexpr (std::is_integral_v<T>)
+            x = T(gen() % 2001) - 1000;
+        else
+            x = T(std::uniform_real_distribution<double>(-1, 1)(gen));
+    }
+    return m;
+}
+
+// i k j order, the textbook loop that runs through rows of b and c
+template<class T>
+dyn_mat<T> naive_mul(dyn_mat<T> const& a, dyn_mat<T> const& b)
+{
+    dyn_mat<T> c(a.rows, b.cols);
+    for (size_t i = 0; i < a.rows; ++i)
+        for (size_t k = 0; k < a.cols; ++k)
+            for (size_t j = 0; j < b.cols; ++j)
+                c(i, j) += a(i, k) * b(k, j);
+    return c;
+}
+
+// largest difference relative to the sum of the magnitudes of the products
+template<class T>
+double error(dyn_mat<T> const& c, dyn_mat<T> const& ref, dyn_mat<T> const& a, dyn_mat<T> const& b)
+{
+    double worst = 0;
+    for (size_t i = 0; i < c.rows; ++i)
+    {
+        for (size_t j = 0; j < c.cols; ++j)
+        {
+            double scale = 0;
+            for (size_t k = 0; k < a.cols; ++k)
+                scale += std::abs(double(a(i, k)) * double(b(k, j)));
+            const double d = std::abs(double(c(i, j)) - double(ref(i, j)));
+            worst = std::max(worst, scale ? d / scale : d);
+        }
+    }
+    return worst;
+}
+
+template<class T>
+void fuzz(std::mt19937_64& gen, double tolerance)
+{
+    const size_t m = gen() % 300 + 1, k = gen() % 600 + 1, n = gen() % 300 + 1;
+    const auto a = random_mat<T>(gen, m, k), b = random_mat<T>(gen, k, n);
+    const T alpha = T(gen() % 5) - T(2), beta = T(gen() % 3) - T(1);
+
+    auto c = random_mat<T>(gen, m, n);
+    auto ref = naive_mul(a, b) * alpha + c * beta;
+    gemm(c, a, b, alpha, beta);
+    const double e = error(c, ref, a, b);
+    if (e > tolerance)
+    {
+        ++failures;
+        std::cerr << "gemm mismatch for " << m << "x" << k << " * " << k << "x" << n << ", relative error " << e << "\n";
+    }
+}
+
+// a random system, every few with a zero leading column entry so pivoting is needed
+template<class T>
+void fuzz_lu(std::mt19937_64& gen, double tolerance)
+{
+    const size_t n = gen() % 300 + 1, k = gen() % 3 + 1;
+    auto a = random_mat<T>(gen, n, n);
+    if (gen() % 4 == 0)
+        a(0, 0) = T(0);
+    const auto b = random_mat<T>(gen, n, k);
+
+    const dyn_lu_factorization<T> lu(a);
+    const auto x = lu.solve(b);
+    const auto r = a * x - b;
+    double worst = 0;
+    for (auto const& v : r.data)
+        worst = std::max(worst, double(std::abs(v)));
+    if (lu.singular || worst > tolerance * double(n))
+    {
+        ++failures;
+        std::cerr << "lu residual " << worst << " for n = " << n << "\n";
+    }
+}
+
+// |a v - l v| / |v| of every eigenpair against the norm of a, symmetric every few so all values are real
+template<class T>
+void fuzz_eigen(std::mt19937_64& gen, double tolerance)
+{
+    const size_t n = gen() % 60 + 1;
+    auto a = random_mat<T>(gen, n, n);
+    if (gen() % 4 == 0)
+        a = a + transpose(a);
+
+    const auto e = eigen(a, true);
+    double worst = 0, norm = 0;
+    for (auto const& v : a.data)
+        norm += double(v) * double(v);
+    norm = std::sqrt(norm);
+    for (size_t j = 0; e.stats.converged && j < n; ++j)
+    {
+        const double lr = e.values[j].x, li = e.values[j].y;
+        double r = 0, len = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            double xr = -(lr * e.vectors(i, j).x - li * e.vectors(i, j).y);
+            double xi = -(lr * e.vectors(i, j).y + li * e.vectors(i, j).x);
+            for (size_t k = 0; k < n; ++k)
+            {
+                xr += double(a(i, k)) * e.vectors(k, j).x;
+                xi += double(a(i, k)) * e.vectors(k, j).y;
+            }
+            r += xr * xr + xi * xi;
+            len += double(e.vectors(i, j).x) * e.vectors(i, j).x + double(e.vectors(i, j).y) * e.vectors(i, j).y;
+        }
+        worst = std::max(worst, std::sqrt(r / len) / norm);
+    }
+    if (!e.stats.converged || worst > tolerance * double(n))
+    {
+        ++failures;
+        std::cerr << "eigen residual " << worst << " after " << e.stats.iterations << " iterations for n = " << n << "\n";
+    }
+}
+
+template<class T, int R, int C>
+mat<T, R, C> random_small(std::mt19937_64& gen, double lo = -1)
+{
+    mat<T, R, C> m;
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            m(i, j) = T(std::uniform_real_distribution<double>(lo, 1)(gen));
+    return m;
+}
+
+// no kernel is specialized on long double, so this takes the loops the kernels replace
+template<class T, int R, int C>
+mat<long double, R, C> widen(mat<T, R, C> const& m)
+{
+    mat<long double, R, C> w;
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            w(i, j) = m(i, j);
+    return w;
+}
+
+template<class T, int R, int C>
+double max_diff(mat<T, R, C> const& m, mat<long double, R, C> const& ref)
+{
+    double worst = 0;
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            worst = std::max(worst, double(std::abs((long double)m(i, j) - ref(i, j))));
+    return worst;
+}
+
+// elements are in [-1, 1], so absolute errors are bounded by a few epsilon times the dimension,
+// the inverse is compared relative to the condition estimate |m| |m^-1| and skipped when that is large
+template<class T, int N>
+void fuzz_kernel(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    const auto x = random_small<T, N, N>(gen), y = random_small<T, N, N>(gen), d = random_small<T, N, N>(gen, 0.5);
+    const auto v = random_small<T, 1, N>(gen);
+    const T s = T(std::uniform_real_distribution<double>(-1, 1)(gen));
+    const auto wx = widen(x), wy = widen(y);
+
+    auto in_place = x;
+    in_place += y;
+    in_place *= s;
+    const double e = std::max({ max_diff(x * y, wx * wy), max_diff(v * x, widen(v) * wx), max_diff(transpose(x), transpose(wx)),
+        max_diff(x + y, wx + wy), max_diff(x - y, wx - wy), max_diff(x * s, wx * (long double)s), max_diff(comp_mul(x, y), comp_mul(wx, wy)),
+        max_diff(comp_div(x, d), comp_div(wx, widen(d))), max_diff(in_place, (wx + wy) * (long double)s),
+        max_diff(v + v, widen(v) + widen(v)), max_diff(mat<T, 1, 1>(determinant(x)), mat<long double, 1, 1>(determinant(wx))) });
+    if (e > tolerance * N)
+    {
+        ++failures;
+        std::cerr << "kernel mismatch for " << type << " " << N << "x" << N << ", error " << e << "\n";
+    }
+
+    const auto inv = inverse(wx);
+    long double norm = 0, inv_norm = 0;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+        {
+            norm = std::max(norm, std::abs(wx(i, j)));
+            inv_norm = std::max(inv_norm, std::abs(inv(i, j)));
+        }
+    const double cond = double(N * norm * inv_norm);
+    if (cond < 1e3 && max_diff(inverse(x), inv) > tolerance * cond * double(inv_norm))
+    {
+        ++failures;
+        std::cerr << "kernel inverse mismatch for " << type << " " << N << "x" << N << ", condition " << cond << "\n";
+    }
+}
+
+template<class T, int R, int C>
+mat<T, R, C> random_entries(std::mt19937_64& gen)
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        mat<T, R, C> m;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                m(i, j) = T(gen() % 21) - T(10);
+        return m;
+    }
+    else
+        return random_small<T, R, C>(gen);
+}
+
+// lazy chains and reductions against the eager operators on the same values, exact for integers,
+// and assignments that read their destination, which a row at a time evaluation would overwrite before reading
+template<class T, int N>
+void fuzz_expr(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    const auto a = random_entries<T, N, N>(gen), b = random_entries<T, N, N>(gen), c = random_entries<T, N, N>(gen);
+    const auto tall = random_entries<T, N, 3>(gen);
+    const auto wide = random_entries<T, 3, N>(gen);
+    const T s = std::is_integral_v<T> ? T(3) : T(0.75);
+    const auto d = a * b - mat<T, N, N>::identity();
+
+    auto x = a;
+    assign(x, lazy(x) * b);
+    auto y = a;
+    y += transpose(lazy(y));
+    auto z = a;
+    z -= lazy(z) * b;
+    auto w = a;
+    assign(w, comp_mul(lazy(w), b) + lazy(w));
+    auto v = a;
+    v += lazy(transpose(v));
+    mat<T, N, N> u = a;
+    u = lazy(u) * b;
+
+    const double e = std::max({ max_diff(mat<T, N, N>(lazy(a) * b - lazy_identity<T, N>()), widen(d)),
+        max_diff(mat<T, N, N>(comp_mul(lazy(a) + b, c) * s - transform<neg<T>>(lazy(c)) / s), widen(comp_mul(a + b, c) * s - transform<neg<T>>(c) / s)),
+        max_diff(mat<T, N, N>(lazy(tall) * wide + transpose(lazy(a))), widen(tall * wide + transpose(a))),
+        max_diff(mat<T, 1, 1>(squared_norm(lazy(a) * b - lazy_identity<T, N>())), mat<long double, 1, 1>(fold_add(widen(comp_mul(d, d))))),
+        max_diff(mat<T, 1, 1>(fold_add(lazy(a) - c)), mat<long double, 1, 1>(fold_add(widen(a - c)))),
+        max_diff(mat<T, 1, 1>(fold_mul(lazy(a) - a + b)), mat<long double, 1, 1>(fold_mul(widen(b)))),
+        max_diff(x, widen(a * b)), max_diff(y, widen(a + transpose(a))), max_diff(z, widen(a - a * b)),
+        max_diff(w, widen(comp_mul(a, b) + a)), max_diff(v, widen(a + transpose(a))), max_diff(u, widen(a * b)) });
+    if (e > tolerance * N)
+    {
+        ++failures;
+        std::cerr << "lazy expression mismatch for " << type << " " << N << "x" << N << ", error " << e << "\n";
+    }
+}
+
+// coefficient i of det(x I - m) is at most binomial(N, i) rho^(N - i) for rho the largest absolute row sum,
+// the float coefficients are compared relative to that
+template<class T, class U, int N>
+double characteristic_error(polynomial<T, N> const& p, polynomial<U, N> const& ref, double rho)
+{
+    double worst = 0, binomial = 1;
+    for (int i = N; i >= 0; --i)
+    {
+        worst = std::max(worst, double(std::abs((long double)p.data[i] - (long double)ref.data[i])) / (binomial * std::pow(rho, N - i)));
+        binomial = binomial * i / (N - i + 1);
+    }
+    return worst;
+}
+
+// small integer matrices take the division free berkowitz path as i64 and the hessenberg recurrence as f64 and long double,
+// all three have to agree with each other, with the determinant and with the trace
+template<int N>
+void fuzz_characteristic(std::mt19937_64& gen)
+{
+    mat<i64, N, N> m;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            m(i, j) = i64(gen() % 19) - 9;
+    // a zero column below the diagonal every few, so the reduction has nothing to eliminate
+    if (gen() % 4 == 0)
+        for (int i = 1; i < N; ++i)
+            m(i, 0) = 0;
+    mat<f64, N, N> x;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            x(i, j) = f64(m(i, j));
+
+    const auto p = characteristic_polynomial(m);
+    i64 trace = 0;
+    double rho = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        trace += m(i, i);
+        double row = 0;
+        for (int j = 0; j < N; ++j)
+            row += std::abs(double(m(i, j)));
+        rho = std::max(rho, row);
+    }
+    const i64 det = determinant(m);
+    const double e = characteristic_error(characteristic_polynomial(x), p, rho);
+    const double ew = characteristic_error(characteristic_polynomial(widen(x)), p, rho);
+    if (p.data[N] != 1 || p.data[N - 1] != -trace || p.data[0] != (N % 2 ? -det : det) || e > 1e-14 || ew > 1e-17)
+    {
+        ++failures;
+        std::cerr << "characteristic polynomial mismatch for " << N << "x" << N << ", error " << e << " and " << ew << "\n";
+    }
+
+    // and the recurrence alone on real values, against itself in long double
+    const auto y = random_small<f64, N, N>(gen);
+    const auto q = characteristic_polynomial(widen(y));
+    double ry = 0, ty = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        ty += y(i, i);
+        double row = 0;
+        for (int j = 0; j < N; ++j)
+            row += std::abs(y(i, j));
+        ry = std::max(ry, row);
+    }
+    const double scale = std::pow(ry, N);
+    const double ey = characteristic_error(characteristic_polynomial(y), q, ry);
+    if (ey > 1e-14 || std::abs(double(q.data[0]) - (N % 2 ? -1 : 1) * double(determinant(widen(y)))) > 1e-15 * scale
+        || std::abs(double(q.data[N - 1]) + ty) > 1e-15 * ry)
+    {
+        ++failures;
+        std::cerr << "characteristic polynomial mismatch for real " << N << "x" << N << ", error " << ey << "\n";
+    }
+}
+
+template<class T>
+void time_sizes(std::mt19937_64& gen, char const* type, options const& opt, bool& first)
+{
+    for (size_t n : opt.sizes)
+    {
+        const auto a = random_mat<T>(gen, n, n), b = random_mat<T>(gen, n, n);
+        dyn_mat<T> c;
+        const double flops = 2.0 * double(n) * double(n) * double(n);
+
+        const dyn_lu_factorization<T> lu(a);
+        const auto rhs = random_mat<T>(gen, n, 1);
+
+        // flops of the factorization and of a solve for one right hand side
+        std::vector<std::tuple<char const*, double, double>> results;
+        results.push_back({ "gemm", ns_per_run([&] { gemm(c, a, b); }, opt), flops });
+        if (n <= opt.naive_max)
+            results.push_back({ "naive", ns_per_run([&] { c = naive_mul(a, b); }, opt), flops });
+        results.push_back({ "lu", ns_per_run([&] { dyn_lu_factorization<T> f(a); }, opt), flops / 3 });
+        results.push_back({ "lu_solve", ns_per_run([&] { c = lu.solve(rhs); }, opt), 2.0 * double(n) * double(n) });
+        // the usual 10 n^3 estimate for hessenberg reduction and qr iterations without vectors
+        if (n <= opt.eigen_max)
+            results.push_back({ "eigen", ns_per_run([&] { eigen(a); }, opt), 5 * flops });
+
+        for (auto const& [op, ns, work] : results)
+            print_result(first, { { "op", op }, { "type", type }, { "n", n }, { "ms", ns / 1e6 }, { "gflops", work / ns } });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    opt.sizes = { 64, 128, 256, 512, 1024, 2048 };
+    parse(argc, argv, opt, [&](std::string const& key, std::string const& value)
+    {
+        if ("naive_max" == key)
+            opt.naive_max = std::stoul(value);
+        else if ("eigen_max" == key)
+            opt.eigen_max = std::stoul(value);
+        else
+            return false;
+        return true;
+    });
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+    {
+        fuzz<f64>(gen, 1e-14);
+        fuzz<f32>(gen, 1e-5);
+        fuzz<i64>(gen, 0);
+        fuzz_lu<f64>(gen, 1e-10);
+        fuzz_eigen<f64>(gen, 1e-13);
+        fuzz_kernel<f32, 3>(gen, "f32", 1e-6);
+        fuzz_kernel<f32, 4>(gen, "f32", 1e-6);
+        fuzz_kernel<f64, 4>(gen, "f64", 1e-15);
+        fuzz_expr<f32, 4>(gen, "f32", 1e-6);
+        fuzz_expr<f64, 3>(gen, "f64", 1e-15);
+        fuzz_expr<f64, 5>(gen, "f64", 1e-15);
+        fuzz_expr<i64, 4>(gen, "i64", 0);
+        fuzz_characteristic<2>(gen);
+        fuzz_characteristic<3>(gen);
+        fuzz_characteristic<4>(gen);
+        fuzz_characteristic<5>(gen);
+        fuzz_characteristic<6>(gen);
+        fuzz_characteristic<7>(gen);
+        fuzz_characteristic<8>(gen);
+    }
+
+    print_header({ { "f32_lanes", detail::gemm_lanes<f32>::width }, { "f64_lanes", detail::gemm_lanes<f64>::width },
+        { "fuzz_cases", 19 * opt.fuzz } });
+    bool first = true;
+    time_sizes<f32>(gen, "f32", opt, first);
+    time_sizes<f64>(gen, "f64", opt, first);
+    print_footer();
+
+    return failures ? 1 : 0;
+}
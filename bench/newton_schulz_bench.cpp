@@ -0,0 +1,226 @@
+// differential fuzzing and throughput of er::newton_schulz_inverse
+//
+// inverses of random mat and dyn_mat are checked against lu to a tolerance scaled by the condition estimate,
+// zero and singular matrices must not report convergence; then newton schulz is timed against lu and against
+// the gradient descent inverse from main.cpp for 4x4 floats, and against lu for run time sizes; results go to stdout as json
+//
+// usage: eigenray_newton_schulz_bench [fuzz=cases] [ms=time per measurement] [sizes=64,128,...]
+
+#include "bench.hpp"
+
+#include <newton_schulz.hpp>
+
+#include <random>
+#include <set>
+
+using namespace er;
+
+template<class T, int N>
+mat<T, N, N> random_mat(std::mt19937_64& gen)
+{
+    mat<T, N, N> m;
+    for (int i = 0; i < N; ++i)
+        for (int j = 0; j < N; ++j)
+            m(i, j) = T(std::uniform_real_distribution<double>(-1, 1)(gen));
+    return m;
+}
+
+template<class T>
+dyn_mat<T> random_dyn_mat(std::mt19937_64& gen, size_t n)
+{
+    dyn_mat<T> m(n, n);
+    for (auto& x : m.data)
+        x = T(std::uniform_real_distribution<double>(-1, 1)(gen));
+    return m;
+}
+
+template<class M>
+double max_abs(M const& m, size_t n)
+{
+    double worst = 0;
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j)
+            worst = std::max(worst, std::abs(double(m(i, j))));
+    return worst;
+}
+
+// the routine from main.cpp: gradient descent on |x m - I|^2 with a fixed rate, after scaling m to determinant 1,
+// keeping the best 100 candidates and giving up after 77776 steps; only its printing is left out
+template<int N>
+mat<f32, N, N> gradient_descent_inverse(mat<f32, N, N> m, size_t& iterations)
+{
+    const f32 scaling = std::pow(1.f / std::abs(determinant(m)), 1.f / N);
+    m *= scaling;
+
+    mat<f32, N, N> inv = transpose(m);
+    mat<f32, N, N> delta = inv * m - m.identity();
+    auto cost = fold_add(comp_mul(delta, delta));
+
+    struct candidate
+    {
+        f32 cost;
+        mat<f32, N, N> inv;
+        bool operator<(candidate const& c) const { return cost < c.cost; }
+    };
+    std::set<candidate> history;
+    history.insert({ cost, inv });
+
+    const f32 lr = 0.05f;
+    iterations = 0;
+    while (cost > 0.0001f)
+    {
+        if (history.rbegin()->cost > cost)
+        {
+            history.insert({ cost, inv });
+            if (history.size() > 100)
+                history.erase(*history.rbegin());
+        }
+        ++iterations;
+        const auto gradient = delta * transpose(m);
+        if (iterations > 77776)
+        {
+            inv = history.begin()->inv;
+            break;
+        }
+        inv -= lr * gradient;
+        delta = inv * m - m.identity();
+        cost = fold_add(comp_mul(delta, delta));
+    }
+    return scaling * inv;
+}
+
+void check(bool ok, char const* what, char const* type, size_t n)
+{
+    if (!ok)
+    {
+        ++failures;
+        std::cerr << what << " for " << type << " " << n << "x" << n << "\n";
+    }
+}
+
+// agreement with lu relative to the condition estimate |m| |m^-1|
+template<class T, int N>
+void fuzz(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    const auto m = random_mat<T, N>(gen);
+    const auto ns = newton_schulz_inverse(m);
+    const auto ref = inverse(m);
+    const double cond = N * max_abs(m, N) * max_abs(ref, N);
+    if (cond > 1e3)
+        return;
+    check(ns.stats.converged, "no convergence", type, N);
+    check(max_abs(ns.inverse - ref, N) <= tolerance * cond * max_abs(ref, N), "mismatch", type, N);
+
+    check(!newton_schulz_inverse(mat<T, N, N>{}).stats.converged, "zero converged", type, N);
+    auto s = m;
+    for (int j = 0; j < N; ++j)
+        s(N - 1, j) = s(0, j);
+    check(!newton_schulz_inverse(s).stats.converged, "singular converged", type, N);
+}
+
+template<class T>
+void fuzz_dyn(std::mt19937_64& gen, char const* type, double tolerance)
+{
+    const size_t n = gen() % 64 + 1;
+    const auto m = random_dyn_mat<T>(gen, n);
+    const auto ns = newton_schulz_inverse(m);
+    const auto ref = inverse(m);
+    const double cond = double(n) * max_abs(m, n) * max_abs(ref, n);
+    if (cond > 1e4)
+        return;
+    check(ns.stats.converged, "no convergence", type, n);
+    check(max_abs(ns.inverse - ref, n) <= tolerance * cond * max_abs(ref, n), "mismatch", type, n);
+}
+
+void print(bool& first, char const* op, char const* type, size_t n, double ns, double iterations, double residual)
+{
+    print_result(first, { { "op", op }, { "type", type }, { "n", n }, { "ns", ns }, { "iterations", iterations }, { "residual", residual } });
+}
+
+template<class M>
+double residual(M const& m, M const& x, size_t n)
+{
+    const auto r = m * x;
+    double sq = 0;
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j)
+            sq += std::pow(double(r(i, j)) - (i == j ? 1.0 : 0.0), 2);
+    return std::sqrt(sq);
+}
+
+// mean time, iterations and residual over the same well conditioned 4x4 matrices
+void time_fixed(std::mt19937_64& gen, bench_options const& opt, bool& first)
+{
+    constexpr int N = 4;
+    std::vector<mat<f32, N, N>> ms;
+    while (ms.size() < 64)
+    {
+        const auto m = random_mat<f32, N>(gen);
+        if (std::abs(determinant(m)) >= 0.1f)
+            ms.push_back(m);
+    }
+    const double count = double(ms.size());
+
+    size_t k = 0, total = 0;
+    double res = 0;
+    for (auto const& m : ms)
+    {
+        size_t it = 0;
+        res += residual(m, gradient_descent_inverse(m, it), N);
+        total += it;
+    }
+    const double gd = ns_per_run([&] { size_t it; sink = sink + gradient_descent_inverse(ms[k++ % ms.size()], it)(0, 0); }, opt);
+    print(first, "gradient_descent", "f32", N, gd, double(total) / count, res / count);
+
+    total = 0;
+    res = 0;
+    for (auto const& m : ms)
+    {
+        const auto ns = newton_schulz_inverse(m);
+        res += residual(m, ns.inverse, N);
+        total += ns.stats.iterations;
+    }
+    const double ns = ns_per_run([&] { sink = sink + newton_schulz_inverse(ms[k++ % ms.size()]).inverse(0, 0); }, opt);
+    print(first, "newton_schulz", "f32", N, ns, double(total) / count, res / count);
+
+    res = 0;
+    for (auto const& m : ms)
+        res += residual(m, inverse(m), N);
+    const double lu = ns_per_run([&] { sink = sink + inverse(ms[k++ % ms.size()])(0, 0); }, opt);
+    print(first, "inverse", "f32", N, lu, 0, res / count);
+}
+
+void time_dyn(std::mt19937_64& gen, bench_options const& opt, bool& first)
+{
+    for (size_t n : opt.sizes)
+    {
+        const auto m = random_dyn_mat<f64>(gen, n);
+        const auto ns = newton_schulz_inverse(m);
+        print(first, "newton_schulz", "f64", n, ns_per_run([&] { sink = sink + newton_schulz_inverse(m).inverse(0, 0); }, opt),
+            double(ns.stats.iterations), ns.stats.residual);
+        print(first, "inverse", "f64", n, ns_per_run([&] { sink = sink + inverse(m)(0, 0); }, opt), 0, residual(m, inverse(m), n));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench_options opt{ .sizes = { 64, 128, 256, 512 } };
+    parse(argc, argv, opt);
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+    {
+        fuzz<f32, 3>(gen, "f32", 1e-5);
+        fuzz<f32, 4>(gen, "f32", 1e-5);
+        fuzz<f64, 6>(gen, "f64", 1e-13);
+        fuzz_dyn<f64>(gen, "f64", 1e-13);
+    }
+
+    print_header({ { "fuzz_cases", 4 * opt.fuzz } });
+    bool first = true;
+    time_fixed(gen, opt, first);
+    time_dyn(gen, opt, first);
+    print_footer();
+
+    return failures ? 1 : 0;
+}
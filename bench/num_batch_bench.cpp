@@ -0,0 +1,116 @@
+// differential fuzzing and throughput of er::num_batch against per element er::num
+//
+// every lane of add, sub, mul and compare is checked against num reduced to the batch width,
+// then batch and scalar throughput are timed per limb count; results go to stdout as json
+//
+// usage: eigenray_num_batch_bench [count=numbers per batch] [fuzz=batches] [ms=time per measurement] [limbs=2,4,8,...]
+
+#include "bench.hpp"
+
+#include <num_batch.hpp>
+
+#include <random>
+
+using namespace er;
+
+struct options : bench_options
+{
+    size_t count = 4096;
+    std::vector<size_t> limbs = { 2, 4, 8, 16 };
+};
+
+// v as a signed number of limbs 32 bit limbs
+num wrap(num const& v, size_t limbs)
+{
+    const num m = num(1) << (32 * limbs);
+    const num low = v & (m - 1);
+    return low >= (m >> 1) ? low - m : low;
+}
+
+num random_num(std::mt19937_64& gen, size_t limbs)
+{
+    num::digits d((32 * limbs + num::bits - 1) / num::bits);
+    for (auto& x : d)
+        x = gen() % 8 ? digit(gen()) : gen() & 1 ? num::mask : 0;
+    return wrap(num::from_digits(d.data(), d.size()), limbs);
+}
+
+void fuzz(std::mt19937_64& gen)
+{
+    const size_t count = gen() % 37 + 1, la = gen() % 9 + 1, lb = gen() % 9 + 1;
+    std::vector<num> A, B, C;
+    for (size_t j = 0; j < count; ++j)
+    {
+        A.push_back(random_num(gen, la));
+        B.push_back(random_num(gen, lb));
+        C.push_back(gen() % 4 ? random_num(gen, la) : A.back());
+    }
+
+    const num_batch a(A, la), b(B, lb), c(C, la);
+    const num_batch s = a + c, d = a - c, p = a * b;
+    const std::vector<i8> cmp = compare(a, c);
+    for (size_t j = 0; j < count; ++j)
+    {
+        const int order = A[j] < C[j] ? -1 : A[j] == C[j] ? 0 : 1;
+        if (a.get(j) != A[j] || s.get(j) != wrap(A[j] + C[j], la) || d.get(j) != wrap(A[j] - C[j], la)
+            || p.get(j) != A[j] * B[j] || cmp[j] != order)
+        {
+            ++failures;
+            std::cerr << "mismatch for " << A[j] << ", " << B[j] << " and " << C[j] << "\n";
+        }
+    }
+}
+
+template<class F>
+double ns_per_op(F&& f, size_t count, options const& opt)
+{
+    return ns_per_run(f, opt) / double(count);
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    parse(argc, argv, opt, [&](std::string const& key, std::string const& value)
+    {
+        if ("count" == key)
+            opt.count = std::max<size_t>(1, std::stoul(value));
+        else if ("limbs" == key)
+            opt.limbs = parse_sizes(value);
+        else
+            return false;
+        return true;
+    });
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+        fuzz(gen);
+
+    print_header({ { "lanes", detail::batch_lanes::width }, { "count", opt.count }, { "fuzz_batches", opt.fuzz } });
+    bool first = true;
+    for (size_t limbs : opt.limbs)
+    {
+        std::vector<num> A, B, R(opt.count);
+        for (size_t j = 0; j < opt.count; ++j)
+        {
+            A.push_back(random_num(gen, limbs));
+            B.push_back(random_num(gen, limbs));
+        }
+        const num_batch a(A, limbs), b(B, limbs);
+        num_batch r;
+        std::vector<i8> order(opt.count);
+
+        const std::pair<char const*, double> results[] = {
+            { "batch_add", ns_per_op([&] { add(r, a, b); }, opt.count, opt) },
+            { "batch_mul", ns_per_op([&] { mul(r, a, b); }, opt.count, opt) },
+            { "batch_compare", ns_per_op([&] { compare(order.data(), a, b); }, opt.count, opt) },
+            { "num_add", ns_per_op([&] { for (size_t j = 0; j < opt.count; ++j) R[j] = A[j] + B[j]; }, opt.count, opt) },
+            { "num_mul", ns_per_op([&] { for (size_t j = 0; j < opt.count; ++j) R[j] = A[j] * B[j]; }, opt.count, opt) },
+            { "num_compare", ns_per_op([&] { size_t n = 0; for (size_t j = 0; j < opt.count; ++j) n += A[j] < B[j]; sink = sink + n; }, opt.count, opt) },
+        };
+        for (auto const& [op, ns] : results)
+            print_result(first, { { "op", op }, { "limbs", limbs }, { "ns_per_op", ns } });
+    }
+    print_footer();
+
+    return failures ? 1 : 0;
+}
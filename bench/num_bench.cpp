@@ -0,0 +1,394 @@
+// differential fuzzing and throughput of er::num
+//
+// every operator is checked against __int128 (i64 where that is missing) on word sized operands
+// and against the schoolbook kernels and algebraic identities on multi digit operands,
+// montgomery against modular arithmetic through % and xgcd, wide_int against num reduced to its width,
+// one more pass lowers the crossover sizes so toom-3, newton division and the decimal conversion are reached by small operands,
+// and the ntt limits so its 16 bit pieces, threads and toom-3 fallback are too, products from the ntt crossover on
+// and one past the real threading limit are checked against the schoolbook kernel,
+// then timed per operand size; results go to stdout as json
+//
+// usage: eigenray_num_bench [threads=N] [fuzz=cases per thread] [ms=time per measurement] [sizes=1,2,4,...]
+
+#include "bench.hpp"
+
+#include <montgomery.hpp>
+#include <num.hpp>
+#include <wide_int.hpp>
+
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace er;
+
+#if defined(__SIZEOF_INT128__)
+using wide = __int128;
+using narrow = i64;
+#else
+using wide = i64;
+using narrow = i32;
+#endif
+
+struct options : bench_options
+{
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+std::mutex report_mutex;
+
+void report(std::string const& what, num const& a, num const& b)
+{
+    ++failures;
+    std::lock_guard lock(report_mutex);
+    std::cerr << "mismatch in " << what << " for " << a << " and " << b << "\n";
+}
+
+num to_num(wide v)
+{
+#if defined(__SIZEOF_INT128__)
+    return num::shift_digits(num(i64(v >> 64)), 64 / num::bits) + num(u64(v));
+#else
+    return num(v);
+#endif
+}
+
+num random_num(std::mt19937_64& gen, size_t digits)
+{
+    num::digits d(digits);
+    for (auto& x : d)
+    {
+        // runs of all zero and all one digits find carry bugs
+        switch (gen() % 8)
+        {
+        case 0: x = 0; break;
+        case 1: x = num::mask; break;
+        default: x = digit(gen());
+        }
+    }
+    num n = num::from_digits(d.data(), d.size());
+    if (gen() & 1)
+        n.negate();
+    return n;
+}
+
+void fuzz_word(std::mt19937_64& gen)
+{
+    const narrow x = narrow(gen()) >> (gen() % (sizeof(narrow) * 8));
+    const narrow y = narrow(gen()) >> (gen() % (sizeof(narrow) * 8));
+    const wide X = x, Y = y;
+    const num a = x, b = y;
+
+    if (a + b != to_num(X + Y)) report("+", a, b);
+    if (a - b != to_num(X - Y)) report("-", a, b);
+    if (a * b != to_num(X * Y)) report("*", a, b);
+    if (-a != to_num(-X)) report("unary -", a, b);
+    if ((a < b) != (X < Y) || (a == b) != (X == Y)) report("<=>", a, b);
+
+    const size_t s = gen() % (sizeof(narrow) * 8);
+    if ((a & b) != to_num(X & Y) || (a | b) != to_num(X | Y) || (a ^ b) != to_num(X ^ Y)) report("bitwise", a, b);
+    if ((a << s) != to_num(X << s) || (a >> s) != to_num(X >> s)) report("shift", a, b);
+
+    num c = a;
+    c += b;
+    c *= b;
+    c -= a;
+    if (c != to_num((X + Y) * Y - X)) report("in place", a, b);
+
+    if (0 != y)
+    {
+        num r;
+        const num q = divmod(a, b, r);
+        if (q != to_num(X / Y) || r != to_num(X % Y)) report("divmod", a, b);
+    }
+
+    wide g = X < 0 ? -X : X, h = Y < 0 ? -Y : Y;
+    while (h)
+    {
+        const wide t = g % h;
+        g = h;
+        h = t;
+    }
+    if (gcd(a, b) != to_num(g)) report("gcd", a, b);
+}
+
+// the schoolbook kernel is the oracle for the fast multiplication paths, a * a squares
+bool product_matches(num const& a, num const& b)
+{
+    const num p = a * b;
+    num ma = abs(a), mb = abs(b);
+    num::digits ref(ma.data.size() + mb.data.size() + 1);
+    num::mul_basecase(ref.data(), ma.data.data(), ma.data.size(), mb.data.data(), mb.data.size());
+    return abs(p) == num::from_digits(ref.data(), ref.size()) && (p < 0) == ((a < 0) != (b < 0) && p != 0);
+}
+
+void fuzz_digits(std::mt19937_64& gen)
+{
+    const num a = random_num(gen, gen() % 300);
+    const num b = random_num(gen, gen() % 300);
+
+    if (!product_matches(a, b)) report("* oracle", a, b);
+
+    if (a + b - b != a || a - b != -(b - a)) report("+ -", a, b);
+    if (((a <=> b) < 0) != ((a - b) < 0)) report("<=>", a, b);
+
+    if (0 != b)
+    {
+        num r;
+        const num q = divmod(a, b, r);
+        if (q * b + r != a || !(abs(r) < abs(b)) || (r != 0 && (r < 0) != (a < 0))) report("divmod", a, b);
+    }
+
+    if (num::from_decimal_string(as_decimal_string(a)) != a) report("decimal", a, b);
+    if (num::from_hex_string(as_hex_string(a)) != a) report("hex", a, b);
+    for (char const* empty : { "", "-", "+" })
+        if (num::from_decimal_string(empty) != 0 || num::from_hex_string(empty) != 0 || num::from_hex_string(std::string(empty) + "0x") != 0)
+            report("empty string", a, b);
+
+    num x, y;
+    const num g = xgcd(a, b, x, y);
+    if (g != gcd(a, b) || a * x + b * y != g) report("xgcd", a, b);
+    if (0 != g && (a % g != 0 || b % g != 0 || gcd(a / g, b / g) != 1)) report("gcd", a, b);
+}
+
+// products of at least digits digits, unbalanced and squared
+void fuzz_ntt(std::mt19937_64& gen, size_t digits)
+{
+    const num a = random_num(gen, digits + gen() % (digits / 2 + 1));
+    const num b = random_num(gen, digits + gen() % 16);
+    if (!product_matches(a, b)) report("ntt * oracle", a, b);
+    if (!product_matches(a, a)) report("ntt square oracle", a, a);
+}
+
+// a^e mod m by square and multiply through %
+num pow_mod(num a, num e, num const& m)
+{
+    num r = 1;
+    a = a % m;
+    while (0 != e)
+    {
+        if (e.get(0) & 1)
+            r = r * a % m;
+        a = a * a % m;
+        e >>= 1;
+    }
+    return r;
+}
+
+void fuzz_montgomery(std::mt19937_64& gen)
+{
+    num m = abs(random_num(gen, gen() % 40 + 1));
+    if (!(m.get(0) & 1))
+        m += 1;
+    if (m <= 1)
+        return;
+    const num a = random_num(gen, gen() % 50), e = abs(random_num(gen, gen() % 4));
+    montgomery ctx(m);
+    num reduced = a % m;
+    if (reduced < 0)
+        reduced += m;
+    if (ctx.pow(a, e) != pow_mod(reduced, e, m)) report("montgomery pow", a, m);
+
+    num::digits x(ctx.size()), y(ctx.size());
+    ctx.to_montgomery(x.data(), a);
+    num u, v;
+    const bool invertible = xgcd(reduced, m, u, v) == 1;
+    if (ctx.inverse(y.data(), x.data()) != invertible) report("montgomery inverse", a, m);
+    else if (invertible && (ctx.from_montgomery(y.data()) - u) % m != 0) report("montgomery inverse", a, m);
+}
+
+void fuzz_wide(std::mt19937_64& gen)
+{
+    using wide_t = wide_int<256, true>;
+    const num a = random_num(gen, gen() % (256 / num::bits + 2));
+    const num b = random_num(gen, gen() % (256 / num::bits + 2));
+    const wide_t x(a), y(b);
+
+    // num reduced to the signed 256 bit range
+    auto wrap = [](num const& v)
+    {
+        const num m = num(1) << 256;
+        const num low = v & (m - 1);
+        return low >= (m >> 1) ? low - m : low;
+    };
+    const num wa = wrap(a), wb = wrap(b);
+    if (num(x) != wa) report("wide_int from num", a, b);
+    if (num(x + y) != wrap(wa + wb) || num(x - y) != wrap(wa - wb) || num(x * y) != wrap(wa * wb)) report("wide_int arithmetic", a, b);
+    if (num(x ^ y) != wrap(wa ^ wb) || num(x >> 7) != (wa >> 7) || num(x << 7) != wrap(wa << 7)) report("wide_int bitwise", a, b);
+    if ((x < y) != (wa < wb)) report("wide_int <=>", a, b);
+    if (0 != wb)
+    {
+        num r;
+        const num q = divmod(wa, wb, r);
+        wide_t wr;
+        const wide_t wq = divmod(x, y, wr);
+        if (num(wq) != wrap(q) || num(wr) != r) report("wide_int divmod", a, b);
+    }
+}
+
+// the crossovers are process wide, so this runs on one thread with nothing else using num
+void fuzz_lowered(size_t cases)
+{
+    const size_t karatsuba = num::karatsuba_threshold, toom3 = num::toom3_threshold, newton = num::newton_division_threshold;
+    const size_t decimal = num::decimal_basecase_digits;
+    num::karatsuba_threshold = 4;
+    num::toom3_threshold = 8;
+    num::newton_division_threshold = 8;
+    num::decimal_basecase_digits = 2;
+
+    std::mt19937_64 gen(~size_t(0));
+    for (size_t i = 0; i < cases; ++i)
+    {
+        fuzz_digits(gen);
+        fuzz_montgomery(gen);
+    }
+
+    // products of a few hundred digits then go through threads, 16 bit pieces or back to toom-3 by length
+    const size_t ntt_crossover = num::ntt_threshold, parallel = ntt::parallel_threshold;
+    const size_t max_length = ntt::max_length, max_length_32 = ntt::max_length_32;
+    num::ntt_threshold = 16;
+    ntt::parallel_threshold = 256;
+    ntt::max_length_32 = 256;
+    ntt::max_length = 1024;
+    for (size_t i = 0; i < cases; ++i)
+        fuzz_digits(gen);
+
+    num::karatsuba_threshold = karatsuba;
+    num::toom3_threshold = toom3;
+    num::newton_division_threshold = newton;
+    num::decimal_basecase_digits = decimal;
+    num::ntt_threshold = ntt_crossover;
+    ntt::parallel_threshold = parallel;
+    ntt::max_length = max_length;
+    ntt::max_length_32 = max_length_32;
+}
+
+struct measurement
+{
+    std::string op;
+    size_t digits = 0;
+    double ops_per_sec = 0;
+    double allocs_per_op = 0;
+};
+
+struct benchmark
+{
+    char const* name;
+    std::function<size_t(num const&, num const&)> run;
+};
+
+std::vector<benchmark> benchmarks()
+{
+    return {
+        { "add", [](num const& a, num const& b) { return (a + b).data.size(); } },
+        { "sub", [](num const& a, num const& b) { return (a - b).data.size(); } },
+        { "add_assign", [](num const& a, num const& b) { num c = a; c += b; return c.data.size(); } },
+        { "mul", [](num const& a, num const& b) { return (a * b).data.size(); } },
+        { "sqr", [](num const& a, num const&) { return (a * a).data.size(); } },
+        { "div", [](num const& a, num const& b) { return (a / b).data.size(); } },
+        { "mod", [](num const& a, num const& b) { return (a % b).data.size(); } },
+        { "cmp", [](num const& a, num const& b) { return size_t(a < b); } },
+        { "negate", [](num const& a, num const&) { return (-a).data.size(); } },
+        { "gcd", [](num const& a, num const& b) { return gcd(a, b).data.size(); } },
+        { "to_decimal", [](num const& a, num const&) { return as_decimal_string(a).size(); } },
+    };
+}
+
+// ops/sec summed over all threads, each thread cycles through its own operands
+measurement measure(benchmark const& bm, size_t digits, options const& opt)
+{
+    std::atomic<size_t> ops = 0, allocs = 0, sink = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < opt.threads; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            std::mt19937_64 gen(t * 7919 + digits);
+            // a second operand of half the size keeps quotients non trivial
+            std::vector<std::pair<num, num>> operands;
+            for (int i = 0; i < 16; ++i)
+            {
+                num b = random_num(gen, std::max<size_t>(1, digits / 2));
+                if (0 == b)
+                    b = 1;
+                operands.emplace_back(random_num(gen, digits), std::move(b));
+            }
+
+            const size_t allocs_before = small_vector_allocations;
+            const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(opt.ms);
+            size_t n = 0, s = 0;
+            while (std::chrono::steady_clock::now() < end)
+            {
+                for (auto const& [a, b] : operands)
+                    s += bm.run(a, b);
+                n += operands.size();
+            }
+            ops += n;
+            allocs += small_vector_allocations - allocs_before;
+            sink += s;
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    return { bm.name, digits, ops * 1000.0 / double(opt.ms), double(allocs) / double(std::max<size_t>(ops, 1)) };
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    opt.fuzz = 100000;
+    opt.sizes = { 1, 2, 4, 16, 64, 256, 1024 };
+    parse(argc, argv, opt, [&](std::string const& key, std::string const& value)
+    {
+        if ("threads" == key)
+            opt.threads = std::max<size_t>(1, std::stoul(value));
+        return "threads" == key;
+    });
+
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < opt.threads; ++t)
+        {
+            threads.emplace_back([&opt, t]
+            {
+                std::mt19937_64 gen(t);
+                for (size_t i = 0; i < opt.fuzz; ++i)
+                    fuzz_word(gen);
+                for (size_t i = 0; i < opt.fuzz / 100; ++i)
+                {
+                    fuzz_digits(gen);
+                    fuzz_montgomery(gen);
+                }
+                for (size_t i = 0; i < opt.fuzz / 10; ++i)
+                    fuzz_wide(gen);
+                for (size_t i = 0; i < opt.fuzz / 10000; ++i)
+                    fuzz_ntt(gen, num::ntt_threshold);
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+    }
+    fuzz_lowered(opt.fuzz / 100);
+    {
+        // 32 bit pieces of both operands fill a transform of parallel_threshold
+        std::mt19937_64 gen(opt.threads);
+        fuzz_ntt(gen, ntt::parallel_threshold / (4 * (num::bits / 32)) + 1);
+    }
+
+    print_header({ { "digit_bits", num::bits }, { "threads", opt.threads },
+        { "fuzz_cases", opt.threads * (opt.fuzz + 2 * (opt.fuzz / 100) + opt.fuzz / 10 + opt.fuzz / 10000) + 3 * (opt.fuzz / 100) + 1 } });
+    bool first = true;
+    for (auto const& bm : benchmarks())
+    {
+        for (size_t digits : opt.sizes)
+        {
+            const measurement m = measure(bm, digits, opt);
+            print_result(first, { { "op", m.op.c_str() }, { "digits", m.digits }, { "ops_per_sec", m.ops_per_sec }, { "allocs_per_op", m.allocs_per_op } });
+        }
+    }
+    print_footer();
+
+    return failures ? 1 : 0;
+}
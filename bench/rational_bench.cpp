@@ -0,0 +1,237 @@
+// differential fuzzing and throughput of er::rational
+//
+// every operator is checked against cross multiplied num arithmetic on signed operands, results computed lazily
+// against the same steps reduced after every one, one more pass lowers reduce_bits so implicit reductions run on small
+// operands, f64 and f32 values round trip bit for bit, subnormals included, and the float conversion is checked
+// to be nearest with ties to even, then lazy and eager harmonic sums are timed; results go to stdout as json
+//
+// usage: eigenray_rational_bench [fuzz=cases] [ms=time per measurement] [sizes=16,64,...]
+
+#include "bench.hpp"
+
+#include <rational.hpp>
+
+#include <bit>
+#include <random>
+
+using namespace er;
+
+void report(std::string const& what, rational const& a, rational const& b)
+{
+    ++failures;
+    std::cerr << "mismatch in " << what << " for " << a << " and " << b << "\n";
+}
+
+num random_num(std::mt19937_64& gen, size_t digits)
+{
+    num::digits d(digits);
+    for (auto& x : d)
+        x = gen() % 8 ? digit(gen()) : gen() & 1 ? num::mask : 0;
+    num n = num::from_digits(d.data(), d.size());
+    if (gen() & 1)
+        n.negate();
+    return n;
+}
+
+// finite, with subnormals, negative exponents and the extremes over represented
+template<class F>
+F random_floating(std::mt19937_64& gen)
+{
+    using limits = std::numeric_limits<F>;
+    using bits = std::conditional_t<sizeof(F) == 8, u64, u32>;
+    constexpr bits sign = bits(1) << (8 * sizeof(F) - 1);
+    constexpr bits mantissa = (bits(1) << (limits::digits - 1)) - 1;
+    switch (gen() % 5)
+    {
+    case 0:
+        for (;;)
+            if (const F f = std::bit_cast<F>(bits(gen())); std::isfinite(f))
+                return f;
+    case 1: return std::bit_cast<F>(bits(gen()) & (sign | mantissa));
+    case 2: return std::ldexp(F(std::uniform_real_distribution<double>(-1, 1)(gen)), -int(gen() % (limits::digits - limits::min_exponent)));
+    case 3: return F(i64(gen()) >> (gen() % 64));
+    default:
+    {
+        const F special[] = { limits::min(), limits::denorm_min(), limits::max(), limits::lowest(), F(1), F(-1), F(0.1) };
+        return special[gen() % std::size(special)];
+    }
+    }
+}
+
+// r is n / d, d != 0 of either sign
+bool equals(rational const& r, num const& n, num const& d)
+{
+    return r.denom > 0 && r.nom * d == n * r.denom;
+}
+
+// the lazy policy bounds the denominator by twice its size at the last reduction
+bool bounded(rational const& r)
+{
+    return bit_length(r.denom) <= std::max(rational::reduce_bits, 2 * r.reduced_bits);
+}
+
+void fuzz_arithmetic(std::mt19937_64& gen)
+{
+    const num n1 = random_num(gen, gen() % 6), n2 = random_num(gen, gen() % 6);
+    num d1 = random_num(gen, gen() % 6 + 1), d2 = gen() % 4 ? random_num(gen, gen() % 6 + 1) : d1;
+    if (0 == d1)
+        d1 = -1;
+    if (0 == d2)
+        d2 = 3;
+    const rational a(n1, d1), b(n2, d2);
+
+    if (!equals(a, n1, d1) || !equals(b, n2, d2)) report("construction", a, b);
+    if (!equals(-a, -n1, d1)) report("unary -", a, b);
+    const rational sum = a + b, difference = a - b, product = a * b;
+    if (!equals(sum, n1 * d2 + n2 * d1, d1 * d2) || !bounded(sum)) report("+", a, b);
+    if (!equals(difference, n1 * d2 - n2 * d1, d1 * d2) || !bounded(difference)) report("-", a, b);
+    if (!equals(product, n1 * n2, d1 * d2) || !bounded(product)) report("*", a, b);
+    if (0 != n2)
+    {
+        const rational quotient = a / b;
+        if (!equals(quotient, n1 * d2, d1 * n2) || !bounded(quotient)) report("/", a, b);
+    }
+
+    // the sign of n1 / d1 - n2 / d2 is that of (n1 d2 - n2 d1) d1 d2
+    const num cross = (n1 * d2 - n2 * d1) * d1 * d2;
+    if ((a <=> b) != (cross <=> 0) || (a == b) != (0 == cross)) report("<=>", a, b);
+
+    rational c = a;
+    c += b;
+    c *= b;
+    c -= a;
+    if (!equals(c, (n1 * d2 + n2 * d1) * n2 * d1 - n1 * d1 * d2 * d2, d1 * d2 * d2 * d1)) report("in place", a, b);
+
+    const i64 k = i64(gen()) >> (gen() % 64);
+    if (!equals(rational(k), num(k), 1)) report("from integer", a, rational(k));
+}
+
+// a chain of random steps computed lazily and reduced after every step has to land on the same value,
+// and reducing the lazy result has to give the same canonical pair
+void fuzz_lazy(std::mt19937_64& gen)
+{
+    rational lazy(random_num(gen, 1), num(gen() % 1000 + 1)), eager = reduced(lazy);
+    for (size_t i = 0, steps = gen() % 40 + 1; i < steps; ++i)
+    {
+        num d = random_num(gen, gen() % 3 + 1);
+        if (0 == d)
+            d = 7;
+        const rational b(random_num(gen, gen() % 3), d);
+        switch (gen() % 4)
+        {
+        case 0: lazy += b; eager = reduced(eager + b); break;
+        case 1: lazy -= b; eager = reduced(eager - b); break;
+        case 2: lazy *= b; eager = reduced(eager * b); break;
+        default:
+            if (0 == b.nom)
+                continue;
+            lazy /= b;
+            eager = reduced(eager / b);
+        }
+        if (!bounded(lazy)) report("lazy growth", lazy, b);
+    }
+
+    const rational canonical = reduced(lazy);
+    if (lazy != eager || canonical.nom != eager.nom || canonical.denom != eager.denom || !eager.is_reduced())
+        report("lazy reduction", lazy, eager);
+}
+
+template<class F>
+void fuzz_floating(std::mt19937_64& gen)
+{
+    using bits = std::conditional_t<sizeof(F) == 8, u64, u32>;
+    constexpr F inf = std::numeric_limits<F>::infinity();
+
+    // the conversion is exact and reduced, and converts back bit for bit, -0 has no rational and comes back as +0
+    const F f = random_floating<F>(gen);
+    const rational r(f);
+    const F back = r.template to_floating<F>();
+    if (!r.is_reduced() || (0 == f ? 0 != back || 0 != std::bit_cast<bits>(back) : std::bit_cast<bits>(back) != std::bit_cast<bits>(f)))
+        report("float round trip", r, rational(back));
+
+    // the midpoint of two neighbours goes to the one with an even mantissa
+    const F g = std::nextafter(f, inf);
+    if (std::isfinite(g))
+    {
+        const rational mid = (rational(f) + rational(g)) / rational(2);
+        const F expected = std::bit_cast<bits>(f) & 1 ? g : f;
+        if (mid.template to_floating<F>() != expected) report("float tie", mid, rational(expected));
+    }
+
+    // any other value in range goes to a nearest neighbour, ties to even
+    num d = random_num(gen, gen() % 8 + 1);
+    if (0 == d)
+        d = 1;
+    const rational q(random_num(gen, gen() % 8), d);
+    if (q >= rational(std::numeric_limits<F>::max()) || q <= rational(std::numeric_limits<F>::lowest()))
+        return;
+    const F x = q.template to_floating<F>();
+    const F lo = std::nextafter(x, -inf), hi = std::nextafter(x, inf);
+    if (!std::isfinite(lo) || !std::isfinite(hi))
+        return;
+    auto distance = [&](F y) { const rational t = q - rational(y); return t < 0 ? -t : t; };
+    const rational dx = distance(x), dlo = distance(lo), dhi = distance(hi);
+    if (dlo < dx || dhi < dx || ((dlo == dx || dhi == dx) && std::bit_cast<bits>(x) & 1))
+        report("float rounding", q, rational(x));
+}
+
+// the policy is process wide, so this runs with nothing else using rational
+void fuzz_lowered(std::mt19937_64& gen, size_t cases)
+{
+    const size_t reduce_bits = rational::reduce_bits;
+    for (size_t bits : { 0, 64 })
+    {
+        rational::reduce_bits = bits;
+        for (size_t i = 0; i < cases; ++i)
+        {
+            fuzz_arithmetic(gen);
+            fuzz_lazy(gen);
+        }
+    }
+    rational::reduce_bits = reduce_bits;
+}
+
+// sum of 1 / k for k up to terms, reduced after every step when eager
+rational harmonic(size_t terms, bool eager)
+{
+    rational s;
+    for (size_t k = 1; k <= terms; ++k)
+    {
+        s += rational(num(1), num(k));
+        if (eager)
+            s.reduce();
+    }
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    bench_options opt;
+    opt.fuzz = 2000;
+    opt.sizes = { 16, 64, 256, 1024 };
+    parse(argc, argv, opt);
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+    {
+        fuzz_arithmetic(gen);
+        fuzz_lazy(gen);
+        fuzz_floating<f64>(gen);
+        fuzz_floating<f32>(gen);
+    }
+    fuzz_lowered(gen, opt.fuzz / 10);
+
+    print_header({ { "digit_bits", num::bits }, { "reduce_bits", rational::reduce_bits }, { "fuzz_cases", 4 * opt.fuzz + 4 * (opt.fuzz / 10) } });
+    bool first = true;
+    for (size_t terms : opt.sizes)
+    {
+        for (bool eager : { false, true })
+        {
+            const double ns = ns_per_run([&] { sink = sink + double(bit_length(harmonic(terms, eager).denom)); }, opt);
+            print_result(first, { { "op", "harmonic_sum" }, { "path", eager ? "eager" : "lazy" }, { "terms", terms }, { "ns", ns } });
+        }
+    }
+    print_footer();
+
+    return failures ? 1 : 0;
+}
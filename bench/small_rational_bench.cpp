@@ -0,0 +1,179 @@
+// differential fuzzing and throughput of er::small_rational against er::rational
+//
+// operands are drawn near the i64 limits and around 2^32 so checked_add and checked_mul overflow and results move
+// to rational and back, every operator, comparison and the f64 conversion is checked against rational on the same values,
+// chains mix promoted and inline operands, inline results must be reduced and results that fit must be inline,
+// then the inline path is timed against plain i64 fractions and against rational; results go to stdout as json
+//
+// usage: eigenray_small_rational_bench [count=values per measurement] [fuzz=cases] [ms=time per measurement]
+
+#include "bench.hpp"
+
+#include <rational.hpp>
+
+#include <bit>
+#include <random>
+
+using namespace er;
+
+struct options : bench_options
+{
+    size_t count = 4096;
+};
+
+// results that had to move to rational, so a run shows the promotion was reached
+size_t promoted = 0;
+
+void report(std::string const& what, rational const& a, rational const& b)
+{
+    ++failures;
+    std::cerr << "mismatch in " << what << " for " << a << " and " << b << "\n";
+}
+
+i64 random_i64(std::mt19937_64& gen)
+{
+    const i64 offset = i64(gen() % 1024);
+    switch (gen() % 6)
+    {
+    case 0: return INT64_MAX - offset;
+    case 1: return INT64_MIN + offset;
+    case 2: return (i64(1) << (gen() % 3 + 31)) - offset;
+    case 3: return i64(gen()) >> (gen() % 64);
+    case 4: return i64(1) << (gen() % 63);
+    default: return offset - 512;
+    }
+}
+
+// in i64 and not INT64_MIN, the range small_rational keeps inline
+bool fits(num const& v)
+{
+    return bit_length(v) < 64 && v != INT64_MIN;
+}
+
+// s holds the value of r, reduced with a positive denominator when inline, and inline whenever that fits
+void check(small_rational const& s, rational const& r, char const* what, rational const& a, rational const& b)
+{
+    const rational c = reduced(r);
+    bool ok = s.to_rational() == r && f64(s) == f64(r);
+    if (s.is_small())
+        ok = ok && s.d > 0 && detail::gcd_i64(s.n, s.d) == 1 && s.n == c.nom && s.d == c.denom;
+    else
+        ok = ok && !(fits(c.nom) && fits(c.denom));
+    promoted += !s.is_small();
+    if (!ok)
+        report(what, a, b);
+}
+
+small_rational random_small(std::mt19937_64& gen)
+{
+    i64 d = random_i64(gen);
+    if (0 == d)
+        d = 1;
+    return small_rational(random_i64(gen), d);
+}
+
+void fuzz(std::mt19937_64& gen)
+{
+    const small_rational a = random_small(gen), b = random_small(gen);
+    const rational ra = a.to_rational(), rb = b.to_rational();
+    check(a, ra, "construction", ra, rb);
+
+    check(-a, -ra, "unary -", ra, rb);
+    check(a + b, ra + rb, "+", ra, rb);
+    check(a - b, ra - rb, "-", ra, rb);
+    check(a * b, ra * rb, "*", ra, rb);
+    if (0 != rb)
+        check(a / b, ra / rb, "/", ra, rb);
+    if ((a <=> b) != (ra <=> rb) || (a == b) != (ra == rb)) report("<=>", ra, rb);
+
+    // promoted results feed back in, so big and inline operands mix and some results move back inline
+    small_rational x = a;
+    rational rx = ra;
+    for (size_t i = 0, steps = gen() % 8 + 1; i < steps; ++i)
+    {
+        const small_rational c = gen() % 4 ? random_small(gen) : x;
+        const rational rc = c.to_rational();
+        switch (gen() % 4)
+        {
+        case 0: x += c; rx += rc; break;
+        case 1: x -= c; rx -= rc; break;
+        case 2: x *= c; rx *= rc; break;
+        default:
+            if (0 == rc)
+                continue;
+            x /= c;
+            rx /= rc;
+        }
+        check(x, rx, "chain", rx, rc);
+        if ((x <=> c) != (rx <=> rc)) report("chain <=>", rx, rc);
+    }
+}
+
+// n / d with both below 2^15, so plain i64 fractions never overflow
+struct fraction
+{
+    i64 n, d;
+};
+
+template<class F>
+double ns_per_op(F&& f, size_t count, options const& opt)
+{
+    return ns_per_run(f, opt) / double(count);
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    opt.fuzz = 100000;
+    parse(argc, argv, opt, [&](std::string const& key, std::string const& value)
+    {
+        if ("count" == key)
+            opt.count = std::max<size_t>(1, std::stoul(value));
+        return "count" == key;
+    });
+
+    std::mt19937_64 gen(1);
+    for (size_t i = 0; i < opt.fuzz; ++i)
+        fuzz(gen);
+
+    std::vector<fraction> fa, fb, fr(opt.count);
+    std::vector<small_rational> sa, sb, sr(opt.count);
+    std::vector<rational> ra, rb, rr(opt.count);
+    for (size_t i = 0; i < opt.count; ++i)
+    {
+        const fraction x = { i64(gen() % 65535) - 32767, i64(gen() % 32767) + 1 }, y = { i64(gen() % 65535) - 32767, i64(gen() % 32767) + 1 };
+        fa.push_back(x);
+        fb.push_back(y);
+        sa.emplace_back(x.n, x.d);
+        sb.emplace_back(y.n, y.d);
+        ra.push_back(sa.back().to_rational());
+        rb.push_back(sb.back().to_rational());
+    }
+
+    print_header({ { "count", opt.count }, { "fuzz_cases", opt.fuzz }, { "promoted_results", promoted } });
+    bool first = true;
+    auto run = [&](auto&& f) { return ns_per_op([&] { for (size_t i = 0; i < opt.count; ++i) f(i); }, opt.count, opt); };
+    struct result { char const* op; char const* path; double ns; };
+    const result results[] = {
+        // unreduced, the cheapest a fraction can be
+        { "add", "i64", run([&](size_t i) { fr[i] = { fa[i].n * fb[i].d + fb[i].n * fa[i].d, fa[i].d * fb[i].d }; }) },
+        { "add", "small_rational", run([&](size_t i) { sr[i] = sa[i] + sb[i]; }) },
+        { "add", "rational", run([&](size_t i) { rr[i] = ra[i] + rb[i]; }) },
+        { "mul", "i64", run([&](size_t i) { fr[i] = { fa[i].n * fb[i].n, fa[i].d * fb[i].d }; }) },
+        { "mul", "small_rational", run([&](size_t i) { sr[i] = sa[i] * sb[i]; }) },
+        { "mul", "rational", run([&](size_t i) { rr[i] = ra[i] * rb[i]; }) },
+        { "cmp", "i64", run([&](size_t i) { sink = sink + double(fa[i].n * fb[i].d < fb[i].n * fa[i].d); }) },
+        { "cmp", "small_rational", run([&](size_t i) { sink = sink + double(sa[i] < sb[i]); }) },
+        { "cmp", "rational", run([&](size_t i) { sink = sink + double(ra[i] < rb[i]); }) },
+    };
+    for (size_t i = 0; i < std::size(results); ++i)
+    {
+        // every op lists its i64 row first
+        const double baseline = results[i - i % 3].ns;
+        print_result(first, { { "op", results[i].op }, { "path", results[i].path }, { "ns_per_op", results[i].ns },
+            { "relative_to_i64", results[i].ns / baseline } });
+    }
+    print_footer();
+
+    return failures ? 1 : 0;
+}
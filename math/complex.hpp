@@ -14,7 +14,7 @@ template<class T, int N>
 ER_STATIC_CONSTEXPR bool is_complex<complex<T, N>> = true;
 
 template<class T>
-T conjugate(T const& c) 
+constexpr T conjugate(T const& c) 
 { 
     if constexpr (is_complex<T>) 
         return ~c; 
@@ -39,31 +39,40 @@ struct complex
         row_vec<F, (2 << N)> raw_vec;
     };
 
-    complex(F const& scalar = F(0)) : raw_data{scalar} {}    
-    
+    // constructors set x and y, the members the constant evaluated code reads
+    constexpr complex(F const& scalar = F(0)) : x(scalar), y(F(0)) {}
+
     template<class...Args> 
         requires(sizeof...(Args) == (2<<N) && (std::is_convertible_v<Args, F> && ...))
-    complex(Args&&...args) : raw_data{ F(std::forward<Args>(args))... } {}
-
-    complex(data_t const& x, data_t const& y) : data(x, y) {}
+    constexpr complex(Args&&...args) : complex(from_values(std::array<F, (2 << N)>{ F(std::forward<Args>(args))... }.data())) {}
 
-    friend F magsq(complex const& c) { return fold_add(comp_mul(c.raw_vec, c.raw_vec)); }
-    friend complex unit(complex const& c) { return c / sqrt(magsq(c)); }
-    friend complex inverse(complex const& c) { return ~c / magsq(c); }
-    friend complex operator -(complex const& c) { return {-c.x, -c.y}; }
-    friend complex operator ~(complex const& c) { return {conjugate(c.x), -c.y}; }
-    friend complex operator +(complex const& a, complex const& b) { return {a.data + b.data}; }
-    friend complex operator -(complex const& a, complex const& b) { return {a.data - b.data}; }
+    constexpr complex(data_t const& x, data_t const& y) : x(x), y(y) {}
 
-    friend complex operator *(complex const& a, complex const& b) { return complex(a.x * b.x - conjugate(b.y) * a.y, b.y * a.x + a.y * conjugate(b.x)); }
-    friend complex operator /(complex const& a, complex const& b) { return a * inverse(b); }
-    friend complex operator *(F const& a, complex const& b) { return {a * b.x, a * b.y}; }
-    friend complex operator *(complex const& a, F const& b) { return {a.x * b, a.y * b}; }
-    friend complex operator /(complex const& a, F const& b) { return {a.x / b, a.y / b}; }
-    friend complex operator /(F const& a, complex const& b) { return a * inverse(b); }
-
-    friend bool operator ==(complex const& a, complex const& b) { return a.data == b.data; }
-    friend bool operator !=(complex const& a, complex const& b) { return a.data != b.data; }
+    friend constexpr F magsq(complex const& c)
+    {
+        if (!std::is_constant_evaluated())
+            return fold_add(comp_mul(c.raw_vec, c.raw_vec));
+        if constexpr (0 == N)
+            return c.x * c.x + c.y * c.y;
+        else
+            return magsq(c.x) + magsq(c.y);
+    }
+    friend constexpr complex unit(complex const& c) { return c / sqrt(magsq(c)); }
+    friend constexpr complex inverse(complex const& c) { return ~c / magsq(c); }
+    friend constexpr complex operator -(complex const& c) { return {-c.x, -c.y}; }
+    friend constexpr complex operator ~(complex const& c) { return {conjugate(c.x), -c.y}; }
+    friend constexpr complex operator +(complex const& a, complex const& b) { return {a.x + b.x, a.y + b.y}; }
+    friend constexpr complex operator -(complex const& a, complex const& b) { return {a.x - b.x, a.y - b.y}; }
+
+    friend constexpr complex operator *(complex const& a, complex const& b) { return complex(a.x * b.x - conjugate(b.y) * a.y, b.y * a.x + a.y * conjugate(b.x)); }
+    friend constexpr complex operator /(complex const& a, complex const& b) { return a * inverse(b); }
+    friend constexpr complex operator *(F const& a, complex const& b) { return {a * b.x, a * b.y}; }
+    friend constexpr complex operator *(complex const& a, F const& b) { return {a.x * b, a.y * b}; }
+    friend constexpr complex operator /(complex const& a, F const& b) { return {a.x / b, a.y / b}; }
+    friend constexpr complex operator /(F const& a, complex const& b) { return a * inverse(b); }
+
+    friend constexpr bool operator ==(complex const& a, complex const& b) { return a.x == b.x && a.y == b.y; }
+    friend constexpr bool operator !=(complex const& a, complex const& b) { return !(a == b); }
 
     friend std::ostream& operator <<(std::ostream& os, complex const& c) 
     { 
@@ -78,7 +87,17 @@ struct complex
     }
 
 private:
-    complex(row_vec<data_t, 2> const& data) : data(data) {}
+    template<class, int>
+    friend struct complex;
+
+    // the 2 << N values in order, the first half goes to x
+    static constexpr complex from_values(F const* v)
+    {
+        if constexpr (0 == N)
+            return complex(v[0], v[1]);
+        else
+            return complex(data_t::from_values(v), data_t::from_values(v + (1 << N)));
+    }
 };
 
 template<class T>
@@ -27,17 +27,27 @@ using f64 = double;
         abort(); \
     }
 
+// fully unrolls the loop that follows, for loops over registers that must not spill
+#if defined(__clang__)
+#define ER_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define ER_UNROLL _Pragma("GCC unroll 32")
+#else
+#define ER_UNROLL
+#endif
+
 namespace er
 {
 
 
-template<size_t N, size_t K>
-constexpr size_t binomial_coefficient()
+// T may be a wider type such as wide_int for results past 64 bits
+template<size_t N, size_t K, class T = size_t>
+constexpr T binomial_coefficient()
 {
     if constexpr (0 == K)
-        return 1;
+        return T(1);
     else 
-        return (binomial_coefficient<N,K-1>()*(N-K+1))/K;
+        return (binomial_coefficient<N,K-1,T>()*T(N-K+1))/T(K);
 }
 
 template<class F, class T>
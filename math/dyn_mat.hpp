@@ -0,0 +1,586 @@
+#pragma once
+
+#include <vec.hpp>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+namespace er
+{
+
+template<class T, size_t Alignment>
+struct aligned_allocator
+{
+    using value_type = T;
+
+    template<class U>
+    struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    aligned_allocator() = default;
+    template<class U>
+    aligned_allocator(aligned_allocator<U, Alignment> const&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template<class U>
+    bool operator==(aligned_allocator<U, Alignment> const&) const { return true; }
+};
+
+namespace detail
+{
+
+// register blocking of the gemm micro kernel: an mr x nr block of c stays in registers
+// while kc rank one updates stream through packed panels of a and b
+// mc x kc of a is sized for l2 and kc x nr of b for l1, nc bounds the packed b panel
+template<class T>
+struct scalar_gemm_lanes
+{
+    using type = T;
+    using reg = T;
+    ER_STATIC_CONSTEXPR size_t width = 1, mr = 4, nr_regs = 4, nr = 4;
+    ER_STATIC_CONSTEXPR size_t mc = 64, kc = 256, nc = 1024;
+
+    static reg zero() { return T(0); }
+    static reg load(T const* p) { return *p; }
+    static void store(T* p, reg v) { *p = v; }
+    static reg set1(T x) { return x; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg mul_add(reg a, reg b, reg c) { return a * b + c; }
+};
+
+#if defined(__AVX512F__)
+template<class T>
+struct avx512_gemm_lanes;
+
+template<>
+struct avx512_gemm_lanes<f32>
+{
+    using type = f32;
+    using reg = __m512;
+    ER_STATIC_CONSTEXPR size_t width = 16, mr = 14, nr_regs = 2, nr = 32;
+    ER_STATIC_CONSTEXPR size_t mc = 112, kc = 384, nc = 4096;
+
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg load(f32 const* p) { return _mm512_loadu_ps(p); }
+    static void store(f32* p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(f32 x) { return _mm512_set1_ps(x); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+};
+
+template<>
+struct avx512_gemm_lanes<f64>
+{
+    using type = f64;
+    using reg = __m512d;
+    ER_STATIC_CONSTEXPR size_t width = 8, mr = 14, nr_regs = 2, nr = 16;
+    ER_STATIC_CONSTEXPR size_t mc = 112, kc = 256, nc = 4096;
+
+    static reg zero() { return _mm512_setzero_pd(); }
+    static reg load(f64 const* p) { return _mm512_loadu_pd(p); }
+    static void store(f64* p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg set1(f64 x) { return _mm512_set1_pd(x); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+};
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+template<class T>
+struct avx2_gemm_lanes;
+
+template<>
+struct avx2_gemm_lanes<f32>
+{
+    using type = f32;
+    using reg = __m256;
+    ER_STATIC_CONSTEXPR size_t width = 8, mr = 6, nr_regs = 2, nr = 16;
+    ER_STATIC_CONSTEXPR size_t mc = 144, kc = 256, nc = 4096;
+
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg load(f32 const* p) { return _mm256_loadu_ps(p); }
+    static void store(f32* p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(f32 x) { return _mm256_set1_ps(x); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+};
+
+template<>
+struct avx2_gemm_lanes<f64>
+{
+    using type = f64;
+    using reg = __m256d;
+    ER_STATIC_CONSTEXPR size_t width = 4, mr = 6, nr_regs = 2, nr = 8;
+    ER_STATIC_CONSTEXPR size_t mc = 72, kc = 256, nc = 4080;
+
+    static reg zero() { return _mm256_setzero_pd(); }
+    static reg load(f64 const* p) { return _mm256_loadu_pd(p); }
+    static void store(f64* p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(f64 x) { return _mm256_set1_pd(x); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+};
+#endif
+
+// widest lanes the target was compiled for, e.g. -mavx2 -mfma or -march=native
+template<class T>
+struct gemm_lanes_of { using type = scalar_gemm_lanes<T>; };
+
+#if defined(__AVX512F__)
+template<> struct gemm_lanes_of<f32> { using type = avx512_gemm_lanes<f32>; };
+template<> struct gemm_lanes_of<f64> { using type = avx512_gemm_lanes<f64>; };
+#elif defined(__AVX2__) && defined(__FMA__)
+template<> struct gemm_lanes_of<f32> { using type = avx2_gemm_lanes<f32>; };
+template<> struct gemm_lanes_of<f64> { using type = avx2_gemm_lanes<f64>; };
+#endif
+
+template<class T>
+using gemm_lanes = typename gemm_lanes_of<T>::type;
+
+// mr x nr block of c += packed a panel * packed b panel over kc
+// the register loops are unrolled so the accumulators never spill
+template<class V>
+void gemm_micro_kernel(size_t kc, typename V::type const* a, typename V::type const* b, typename V::type* c, size_t ldc)
+{
+    typename V::reg acc[V::mr][V::nr_regs];
+    ER_UNROLL
+    for (size_t i = 0; i < V::mr; ++i)
+        ER_UNROLL
+        for (size_t j = 0; j < V::nr_regs; ++j)
+            acc[i][j] = V::zero();
+
+    for (size_t p = 0; p < kc; ++p, a += V::mr, b += V::nr)
+    {
+        typename V::reg bv[V::nr_regs];
+        ER_UNROLL
+        for (size_t j = 0; j < V::nr_regs; ++j)
+            bv[j] = V::load(b + j * V::width);
+        ER_UNROLL
+        for (size_t i = 0; i < V::mr; ++i)
+        {
+            const auto av = V::set1(a[i]);
+            ER_UNROLL
+            for (size_t j = 0; j < V::nr_regs; ++j)
+                acc[i][j] = V::mul_add(av, bv[j], acc[i][j]);
+        }
+    }
+
+    ER_UNROLL
+    for (size_t i = 0; i < V::mr; ++i)
+    {
+        ER_UNROLL
+        for (size_t j = 0; j < V::nr_regs; ++j)
+        {
+            auto* p = c + i * ldc + j * V::width;
+            V::store(p, V::add(V::load(p), acc[i][j]));
+        }
+    }
+}
+
+// alpha times mc x kc of a into panels of mr rows, one column of a panel after the other, zero padded
+template<class V, class T = typename V::type>
+void gemm_pack_a(T* dst, T const* a, size_t lda, size_t mc, size_t kc, T const& alpha)
+{
+    for (size_t ir = 0; ir < mc; ir += V::mr)
+        for (size_t p = 0; p < kc; ++p)
+            for (size_t i = 0; i < V::mr; ++i)
+                *dst++ = ir + i < mc ? alpha * a[(ir + i) * lda + p] : T(0);
+}
+
+// kc x nc of b into panels of nr columns, one row of a panel after the other, zero padded
+template<class V, class T = typename V::type>
+void gemm_pack_b(T* dst, T const* b, size_t ldb, size_t kc, size_t nc)
+{
+    for (size_t jr = 0; jr < nc; jr += V::nr)
+    {
+        const size_t n = std::min(V::nr, nc - jr);
+        for (size_t p = 0; p < kc; ++p)
+        {
+            T const* row = b + p * ldb + jr;
+            for (size_t j = 0; j < n; ++j)
+                *dst++ = row[j];
+            for (size_t j = n; j < V::nr; ++j)
+                *dst++ = T(0);
+        }
+    }
+}
+
+// the packed panels of a and b, kept by callers that multiply in a loop so only the first product allocates
+template<class T>
+struct gemm_workspace
+{
+    std::vector<T, aligned_allocator<T, 64>> pa;
+    std::vector<T, aligned_allocator<T, 64>> pb;
+};
+
+// c += alpha a b for row major m x k a, k x n b and m x n c with leading dimensions lda, ldb and ldc
+// goto style: nc columns of b, kc deep, are packed once per mc rows of a,
+// partial tiles at the edges go through a scratch block
+// c may share storage with a and b as long as the blocks do not overlap
+template<class V, class T = typename V::type>
+void gemm_blocked(size_t m, size_t n, size_t k, T const& alpha, T const* a, size_t lda, T const* b, size_t ldb, T* c, size_t ldc,
+    gemm_workspace<T>& ws)
+{
+    if (!m || !n || !k)
+        return;
+
+    auto round_up = [](size_t x, size_t r) { return (x + r - 1) / r * r; };
+    auto& pa = ws.pa;
+    auto& pb = ws.pb;
+    pa.resize(std::max(pa.size(), round_up(std::min(V::mc, m), V::mr) * std::min(V::kc, k)));
+    pb.resize(std::max(pb.size(), round_up(std::min(V::nc, n), V::nr) * std::min(V::kc, k)));
+    T edge[V::mr * V::nr];
+
+    for (size_t jc = 0; jc < n; jc += V::nc)
+    {
+        const size_t nc = std::min(V::nc, n - jc);
+        for (size_t pc = 0; pc < k; pc += V::kc)
+        {
+            const size_t kc = std::min(V::kc, k - pc);
+            gemm_pack_b<V>(pb.data(), b + pc * ldb + jc, ldb, kc, nc);
+            for (size_t ic = 0; ic < m; ic += V::mc)
+            {
+                const size_t mc = std::min(V::mc, m - ic);
+                gemm_pack_a<V>(pa.data(), a + ic * lda + pc, lda, mc, kc, alpha);
+                for (size_t jr = 0; jr < nc; jr += V::nr)
+                {
+                    for (size_t ir = 0; ir < mc; ir += V::mr)
+                    {
+                        T const* ap = pa.data() + ir * kc;
+                        T const* bp = pb.data() + jr * kc;
+                        T* cp = c + (ic + ir) * ldc + jc + jr;
+                        const size_t mr = std::min(V::mr, mc - ir), nr = std::min(V::nr, nc - jr);
+                        if (V::mr == mr && V::nr == nr)
+                        {
+                            gemm_micro_kernel<V>(kc, ap, bp, cp, ldc);
+                            continue;
+                        }
+                        std::fill(edge, edge + V::mr * V::nr, T(0));
+                        gemm_micro_kernel<V>(kc, ap, bp, edge, V::nr);
+                        for (size_t i = 0; i < mr; ++i)
+                            for (size_t j = 0; j < nr; ++j)
+                                cp[i * ldc + j] += edge[i * V::nr + j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<class V, class T = typename V::type>
+void gemm_blocked(size_t m, size_t n, size_t k, T const& alpha, T const* a, size_t lda, T const* b, size_t ldb, T* c, size_t ldc)
+{
+    gemm_workspace<T> ws;
+    gemm_blocked<V>(m, n, k, alpha, a, lda, b, ldb, c, ldc, ws);
+}
+
+}
+
+template<class T>
+struct dyn_lu_factorization;
+
+// heap backed row major matrix with its size chosen at run time, element (i, j) is data[i * cols + j]
+// storage is 64 byte aligned, mat converts both ways
+template<class T>
+struct dyn_mat
+{
+    ER_STATIC_CONSTEXPR size_t alignment = 64;
+
+    size_t rows = 0;
+    size_t cols = 0;
+    std::vector<T, aligned_allocator<T, alignment>> data;
+
+    dyn_mat() = default;
+
+    dyn_mat(size_t rows, size_t cols, T const& value = T(0)) : rows(rows), cols(cols), data(rows * cols, value) {}
+
+    template<int R, int C>
+    dyn_mat(mat<T, R, C> const& m) : dyn_mat(R, C)
+    {
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                (*this)(i, j) = m(i, j);
+    }
+
+    template<int R, int C>
+    explicit operator mat<T, R, C>() const
+    {
+        assert(size_t(R) == rows && size_t(C) == cols);
+        mat<T, R, C> res;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                res(i, j) = (*this)(i, j);
+        return res;
+    }
+
+    static dyn_mat identity(size_t n)
+    {
+        dyn_mat res(n, n);
+        for (size_t i = 0; i < n; ++i)
+            res(i, i) = T(1);
+        return res;
+    }
+
+    T& operator()(size_t i, size_t j) { assert(i < rows && j < cols); return data[i * cols + j]; }
+    T const& operator()(size_t i, size_t j) const { assert(i < rows && j < cols); return data[i * cols + j]; }
+
+    // row i, so m[i][j] works like it does for mat
+    T* operator[](size_t i) { assert(i < rows); return data.data() + i * cols; }
+    T const* operator[](size_t i) const { assert(i < rows); return data.data() + i * cols; }
+
+    friend dyn_mat transpose(dyn_mat const& m)
+    {
+        // tiles keep both the reads and the writes within a few cache lines
+        constexpr size_t tile = 32;
+        dyn_mat res(m.cols, m.rows);
+        for (size_t i0 = 0; i0 < m.rows; i0 += tile)
+            for (size_t j0 = 0; j0 < m.cols; j0 += tile)
+                for (size_t i = i0; i < std::min(i0 + tile, m.rows); ++i)
+                    for (size_t j = j0; j < std::min(j0 + tile, m.cols); ++j)
+                        res(j, i) = m(i, j);
+        return res;
+    }
+
+    // c = alpha a b + beta c, c must not be a or b
+    friend void gemm(dyn_mat& c, dyn_mat const& a, dyn_mat const& b, T const& alpha = T(1), T const& beta = T(0))
+    {
+        detail::gemm_workspace<T> ws;
+        gemm(c, a, b, alpha, beta, ws);
+    }
+
+    // the same packing into ws, which a loop of products can keep so c and ws only allocate the first time
+    friend void gemm(dyn_mat& c, dyn_mat const& a, dyn_mat const& b, T const& alpha, T const& beta, detail::gemm_workspace<T>& ws)
+    {
+        assert(a.cols == b.rows && &c != &a && &c != &b);
+        if (c.rows != a.rows || c.cols != b.cols)
+            c = dyn_mat(a.rows, b.cols);
+        else if (beta != T(1))
+            for (auto& x : c.data)
+                x = beta == T(0) ? T(0) : x * beta;
+        detail::gemm_blocked<detail::gemm_lanes<T>>(a.rows, b.cols, a.cols, alpha, a.data.data(), a.cols, b.data.data(), b.cols,
+            c.data.data(), c.cols, ws);
+    }
+
+    friend dyn_mat operator*(dyn_mat const& a, dyn_mat const& b)
+    {
+        dyn_mat c;
+        gemm(c, a, b);
+        return c;
+    }
+
+    friend T determinant(dyn_mat const& m) { return dyn_lu_factorization<T>(m).determinant(); }
+    friend dyn_mat inverse(dyn_mat const& m) { return dyn_lu_factorization<T>(m).inverse(); }
+
+    template<class F>
+    friend dyn_mat element_wise(dyn_mat const& x, dyn_mat const& y, F&& f)
+    {
+        assert(x.rows == y.rows && x.cols == y.cols);
+        dyn_mat res(x.rows, x.cols);
+        for (size_t i = 0; i < x.data.size(); ++i)
+            res.data[i] = f(x.data[i], y.data[i]);
+        return res;
+    }
+
+    friend dyn_mat operator+(dyn_mat const& x, dyn_mat const& y) { return element_wise(x, y, add<T>); }
+    friend dyn_mat operator-(dyn_mat const& x, dyn_mat const& y) { return element_wise(x, y, sub<T>); }
+    friend dyn_mat comp_mul(dyn_mat const& x, dyn_mat const& y) { return element_wise(x, y, mul<T>); }
+    friend dyn_mat comp_div(dyn_mat const& x, dyn_mat const& y) { return element_wise(x, y, div<T>); }
+
+    friend dyn_mat& operator+=(dyn_mat& x, dyn_mat const& y)
+    {
+        assert(x.rows == y.rows && x.cols == y.cols);
+        for (size_t i = 0; i < x.data.size(); ++i)
+            x.data[i] += y.data[i];
+        return x;
+    }
+
+    friend dyn_mat& operator-=(dyn_mat& x, dyn_mat const& y)
+    {
+        assert(x.rows == y.rows && x.cols == y.cols);
+        for (size_t i = 0; i < x.data.size(); ++i)
+            x.data[i] -= y.data[i];
+        return x;
+    }
+
+    friend dyn_mat& operator*=(dyn_mat& x, T const& y)
+    {
+        for (auto& v : x.data)
+            v *= y;
+        return x;
+    }
+
+    friend dyn_mat& operator/=(dyn_mat& x, T const& y)
+    {
+        for (auto& v : x.data)
+            v /= y;
+        return x;
+    }
+
+    friend dyn_mat operator*(dyn_mat x, T const& y) { return x *= y; }
+    friend dyn_mat operator*(T const& x, dyn_mat y) { return y *= x; }
+    friend dyn_mat operator/(dyn_mat x, T const& y) { return x /= y; }
+
+    dyn_mat operator-() const
+    {
+        dyn_mat res = *this;
+        for (auto& v : res.data)
+            v = -v;
+        return res;
+    }
+
+    friend bool operator==(dyn_mat const& x, dyn_mat const& y)
+    {
+        return x.rows == y.rows && x.cols == y.cols && std::equal(x.data.begin(), x.data.end(), y.data.begin());
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, dyn_mat const& m)
+    {
+        os << "[";
+        for (size_t i = 0; i < m.rows; ++i)
+        {
+            os << '[';
+            for (size_t j = 0; j < m.cols; ++j)
+                os << m(i, j) << (j + 1 == m.cols ? "]" : ", ");
+            os << (i + 1 == m.rows ? "" : ",\n");
+        }
+        return os << "]\n";
+    }
+};
+
+// lu_factorization for a dyn_mat
+// columns are factored in panels of block columns, the trailing matrix is then updated with one gemm per panel
+template<class T>
+struct dyn_lu_factorization
+{
+    ER_STATIC_CONSTEXPR size_t block = 64;
+
+    dyn_mat<T> lu;
+    std::vector<size_t> perm;
+    bool odd = false;
+    bool singular = false;
+
+    explicit dyn_lu_factorization(dyn_mat<T> const& m) : lu(m), perm(m.rows)
+    {
+        assert(m.rows == m.cols);
+        const size_t n = lu.rows;
+        for (size_t i = 0; i < n; ++i)
+            perm[i] = i;
+
+        for (size_t j0 = 0; j0 < n; j0 += block)
+        {
+            const size_t j1 = std::min(j0 + block, n);
+            factor_panel(j0, j1);
+
+            // u12 = l11^-1 a12
+            for (size_t j = j0; j < j1; ++j)
+                for (size_t i = j + 1; i < j1; ++i)
+                    axpy(lu[i] + j1, lu[j] + j1, -lu(i, j), n - j1);
+
+            // a22 -= l21 u12
+            if (j1 < n)
+            {
+                T* a = lu.data.data();
+                detail::gemm_blocked<detail::gemm_lanes<T>>(n - j1, n - j1, j1 - j0, T(-1), a + j1 * n + j0, n, a + j0 * n + j1, n, a + j1 * n + j1, n);
+            }
+        }
+    }
+
+    // x with m x = b for every column of b, O(n^2) per column
+    dyn_mat<T> solve(dyn_mat<T> const& b) const
+    {
+        assert(b.rows == lu.rows);
+        if (singular)
+            return {};
+        const size_t n = lu.rows, k = b.cols;
+        dyn_mat<T> x(n, k);
+
+        // a single column is contiguous, so substitute with dot products along the rows of lu
+        if (1 == k)
+        {
+            for (size_t i = 0; i < n; ++i)
+                x.data[i] = b.data[perm[i]] - dot(lu[i], x.data.data(), i);
+            for (size_t i = n; i-- > 0;)
+                x.data[i] = (x.data[i] - dot(lu[i] + i + 1, x.data.data() + i + 1, n - i - 1)) / lu(i, i);
+            return x;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::copy(b[perm[i]], b[perm[i]] + k, x[i]);
+            for (size_t j = 0; j < i; ++j)
+                axpy(x[i], x[j], -lu(i, j), k);
+        }
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t j = i + 1; j < n; ++j)
+                axpy(x[i], x[j], -lu(i, j), k);
+            for (size_t c = 0; c < k; ++c)
+                x(i, c) /= lu(i, i);
+        }
+        return x;
+    }
+
+    T determinant() const
+    {
+        if (singular)
+            return T(0);
+        T det = T(1);
+        for (size_t i = 0; i < lu.rows; ++i)
+            det *= lu(i, i);
+        return odd ? -det : det;
+    }
+
+    dyn_mat<T> inverse() const { return solve(dyn_mat<T>::identity(lu.rows)); }
+
+private:
+    static T dot(T const* x, T const* y, size_t n)
+    {
+        T s = T(0);
+        for (size_t i = 0; i < n; ++i)
+            s += x[i] * y[i];
+        return s;
+    }
+
+    // y[0..n) += a x[0..n)
+    static void axpy(T* y, T const* x, T const& a, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            y[i] += a * x[i];
+    }
+
+    // unblocked factorization of columns [j0, j1) below row j0, row swaps span the whole matrix
+    void factor_panel(size_t j0, size_t j1)
+    {
+        const size_t n = lu.rows;
+        for (size_t j = j0; j < j1; ++j)
+        {
+            size_t pivot = j;
+            for (size_t i = j + 1; i < n; ++i)
+                if (detail::pivot_magnitude(lu(i, j)) > detail::pivot_magnitude(lu(pivot, j)))
+                    pivot = i;
+            if (lu(pivot, j) == T(0))
+            {
+                singular = true;
+                continue;
+            }
+            if (pivot != j)
+            {
+                std::swap_ranges(lu[j], lu[j] + n, lu[pivot]);
+                std::swap(perm[j], perm[pivot]);
+                odd = !odd;
+            }
+            for (size_t i = j + 1; i < n; ++i)
+            {
+                lu(i, j) /= lu(j, j);
+                axpy(lu[i] + j + 1, lu[j] + j + 1, -lu(i, j), j1 - j - 1);
+            }
+        }
+    }
+};
+
+}
@@ -0,0 +1,607 @@
+#pragma once
+
+#include <dyn_mat.hpp>
+#include <complex.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace er
+{
+
+// what eigen spent its time on
+struct eigen_stats
+{
+    size_t iterations = 0;
+    bool converged = true;
+    double hessenberg_ms = 0;
+    double qr_ms = 0;
+    double vectors_ms = 0;
+};
+
+// values[j] is an eigenvalue and column j of vectors its eigenvector, vectors is empty unless asked for
+// complex values come in conjugate pairs next to each other, the one with positive imaginary part first
+template<class T>
+struct eigen_decomposition
+{
+    std::vector<complex<T>> values;
+    dyn_mat<complex<T>> vectors;
+    eigen_stats stats;
+};
+
+namespace detail
+{
+
+// eigenvalues of a real matrix after the eispack routines orthes and hqr2:
+// householder reduction to hessenberg form, then francis' implicit double shift qr
+// deflates one real or a pair of complex conjugate eigenvalues at a time,
+// eigenvectors come from back substitution in the real schur form and the accumulated transformations
+template<class T>
+struct francis_qr
+{
+    const size_t nn;
+    const bool with_vectors;
+    dyn_mat<T> h, v;
+    std::vector<T> d, e;
+    eigen_stats stats;
+
+    francis_qr(dyn_mat<T> const& m, bool with_vectors) : nn(m.rows), with_vectors(with_vectors), h(m), d(nn), e(nn)
+    {
+        assert(m.rows == m.cols);
+        using clock = std::chrono::steady_clock;
+        auto ms = [](clock::time_point a, clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+        const auto t0 = clock::now();
+        reduce();
+        const auto t1 = clock::now();
+        iterate();
+        const auto t2 = clock::now();
+        if (with_vectors && stats.converged)
+            back_substitute();
+        const auto t3 = clock::now();
+
+        stats.hessenberg_ms = ms(t0, t1);
+        stats.qr_ms = ms(t1, t2);
+        stats.vectors_ms = ms(t2, t3);
+    }
+
+    // h = q^t m q upper hessenberg, v = q when vectors are wanted
+    void reduce()
+    {
+        const size_t n = nn;
+        std::vector<T> ort(n), f(n);
+        for (size_t m = 1; m + 1 < n; ++m)
+        {
+            T scale = T(0);
+            for (size_t i = m; i < n; ++i)
+                scale += std::abs(h(i, m - 1));
+            if (scale == T(0))
+                continue;
+
+            T hh = T(0);
+            for (size_t i = n; i-- > m;)
+            {
+                ort[i] = h(i, m - 1) / scale;
+                hh += ort[i] * ort[i];
+            }
+            T g = std::sqrt(hh);
+            if (ort[m] > T(0))
+                g = -g;
+            hh -= ort[m] * g;
+            ort[m] -= g;
+
+            // h = (i - u u^t / hh) h (i - u u^t / hh), the left product as f = u^t h / hh walking rows
+            std::fill(f.begin() + m, f.end(), T(0));
+            for (size_t i = m; i < n; ++i)
+            {
+                T const* row = h[i];
+                for (size_t j = m; j < n; ++j)
+                    f[j] += ort[i] * row[j];
+            }
+            for (size_t i = m; i < n; ++i)
+            {
+                T* row = h[i];
+                const T u = ort[i] / hh;
+                for (size_t j = m; j < n; ++j)
+                    row[j] -= f[j] * u;
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                T f = T(0);
+                for (size_t j = m; j < n; ++j)
+                    f += ort[j] * h(i, j);
+                f /= hh;
+                for (size_t j = m; j < n; ++j)
+                    h(i, j) -= f * ort[j];
+            }
+            // below the subdiagonal column m - 1 keeps scale * u for the accumulation
+            ort[m] *= scale;
+            h(m, m - 1) = scale * g;
+        }
+
+        if (with_vectors)
+        {
+            v = dyn_mat<T>::identity(n);
+            for (size_t m = n ? n - 1 : 0; m-- > 1;)
+            {
+                if (h(m, m - 1) == T(0))
+                    continue;
+                for (size_t i = m + 1; i < n; ++i)
+                    ort[i] = h(i, m - 1);
+                std::fill(f.begin() + m, f.end(), T(0));
+                for (size_t i = m; i < n; ++i)
+                {
+                    T const* row = v[i];
+                    for (size_t j = m; j < n; ++j)
+                        f[j] += ort[i] * row[j];
+                }
+                // two divisions avoid an underflow of ort[m] * h(m, m - 1)
+                for (size_t j = m; j < n; ++j)
+                    f[j] = (f[j] / ort[m]) / h(m, m - 1);
+                for (size_t i = m; i < n; ++i)
+                {
+                    T* row = v[i];
+                    for (size_t j = m; j < n; ++j)
+                        row[j] += f[j] * ort[i];
+                }
+            }
+        }
+
+        // the householder vectors below the subdiagonal are not needed anymore
+        for (size_t i = 2; i < n; ++i)
+            for (size_t j = 0; j + 1 < i; ++j)
+                h(i, j) = T(0);
+    }
+
+    // columns touched by a transformation of rows, rows touched by one of columns:
+    // the whole schur form when vectors are wanted, else only the active block [l, n]
+    size_t row_end(size_t n) const { return with_vectors ? nn : n + 1; }
+    size_t column_begin(size_t l) const { return with_vectors ? 0 : l; }
+
+    void iterate()
+    {
+        if (!nn)
+            return;
+
+        const T eps = std::numeric_limits<T>::epsilon();
+        const size_t max_iterations = 30 * nn;
+        T exshift = T(0), p = 0, q = 0, r = 0, s = 0, z = 0, w, x, y;
+
+        T norm = T(0);
+        for (size_t i = 0; i < nn; ++i)
+            for (size_t j = i ? i - 1 : 0; j < nn; ++j)
+                norm += std::abs(h(i, j));
+
+        size_t iter = 0;
+        for (ptrdiff_t n = ptrdiff_t(nn) - 1; n >= 0;)
+        {
+            // a negligible subdiagonal element splits off the block [l, n]
+            ptrdiff_t l = n;
+            for (; l > 0; --l)
+            {
+                s = std::abs(h(l - 1, l - 1)) + std::abs(h(l, l));
+                if (s == T(0))
+                    s = norm;
+                if (std::abs(h(l, l - 1)) < eps * s)
+                    break;
+            }
+
+            if (l == n)
+            {
+                // one real root
+                h(n, n) += exshift;
+                d[n] = h(n, n);
+                e[n] = T(0);
+                --n;
+                iter = 0;
+            }
+            else if (l == n - 1)
+            {
+                // two roots, real or a complex conjugate pair
+                w = h(n, n - 1) * h(n - 1, n);
+                p = (h(n - 1, n - 1) - h(n, n)) / T(2);
+                q = p * p + w;
+                z = std::sqrt(std::abs(q));
+                h(n, n) += exshift;
+                h(n - 1, n - 1) += exshift;
+                x = h(n, n);
+
+                if (q >= T(0))
+                {
+                    z = p >= T(0) ? p + z : p - z;
+                    d[n - 1] = x + z;
+                    d[n] = z != T(0) ? x - w / z : d[n - 1];
+                    e[n - 1] = T(0);
+                    e[n] = T(0);
+
+                    // rotate the 2x2 block to upper triangular
+                    x = h(n, n - 1);
+                    s = std::abs(x) + std::abs(z);
+                    p = x / s;
+                    q = z / s;
+                    r = std::sqrt(p * p + q * q);
+                    p /= r;
+                    q /= r;
+                    for (size_t j = n - 1; j < row_end(n); ++j)
+                    {
+                        z = h(n - 1, j);
+                        h(n - 1, j) = q * z + p * h(n, j);
+                        h(n, j) = q * h(n, j) - p * z;
+                    }
+                    for (size_t i = column_begin(l); i <= size_t(n); ++i)
+                    {
+                        z = h(i, n - 1);
+                        h(i, n - 1) = q * z + p * h(i, n);
+                        h(i, n) = q * h(i, n) - p * z;
+                    }
+                    if (with_vectors)
+                    {
+                        for (size_t i = 0; i < nn; ++i)
+                        {
+                            z = v(i, n - 1);
+                            v(i, n - 1) = q * z + p * v(i, n);
+                            v(i, n) = q * v(i, n) - p * z;
+                        }
+                    }
+                }
+                else
+                {
+                    d[n - 1] = x + p;
+                    d[n] = x + p;
+                    e[n - 1] = z;
+                    e[n] = -z;
+                }
+                n -= 2;
+                iter = 0;
+            }
+            else
+            {
+                if (stats.iterations == max_iterations)
+                {
+                    stats.converged = false;
+                    return;
+                }
+
+                // the shifts are the eigenvalues of the trailing 2x2 block
+                x = h(n, n);
+                y = h(n - 1, n - 1);
+                w = h(n, n - 1) * h(n - 1, n);
+
+                // exceptional shifts break cycles, wilkinson's after 10 iterations and matlab's after 30
+                if (10 == iter)
+                {
+                    exshift += x;
+                    for (ptrdiff_t i = 0; i <= n; ++i)
+                        h(i, i) -= x;
+                    s = std::abs(h(n, n - 1)) + std::abs(h(n - 1, n - 2));
+                    x = y = T(0.75) * s;
+                    w = T(-0.4375) * s * s;
+                }
+                if (30 == iter)
+                {
+                    s = (y - x) / T(2);
+                    s = s * s + w;
+                    if (s > T(0))
+                    {
+                        s = std::sqrt(s);
+                        if (y < x)
+                            s = -s;
+                        s = x - w / ((y - x) / T(2) + s);
+                        for (ptrdiff_t i = 0; i <= n; ++i)
+                            h(i, i) -= s;
+                        exshift += s;
+                        x = y = w = T(0.964);
+                    }
+                }
+                ++iter;
+                ++stats.iterations;
+
+                // start the bulge where two consecutive subdiagonal elements are small
+                ptrdiff_t m = n - 2;
+                for (; m >= l; --m)
+                {
+                    z = h(m, m);
+                    r = x - z;
+                    s = y - z;
+                    p = (r * s - w) / h(m + 1, m) + h(m, m + 1);
+                    q = h(m + 1, m + 1) - z - r - s;
+                    r = h(m + 2, m + 1);
+                    s = std::abs(p) + std::abs(q) + std::abs(r);
+                    p /= s;
+                    q /= s;
+                    r /= s;
+                    if (m == l)
+                        break;
+                    if (std::abs(h(m, m - 1)) * (std::abs(q) + std::abs(r))
+                        < eps * (std::abs(p) * (std::abs(h(m - 1, m - 1)) + std::abs(z) + std::abs(h(m + 1, m + 1)))))
+                        break;
+                }
+
+                for (ptrdiff_t i = m + 2; i <= n; ++i)
+                {
+                    h(i, i - 2) = T(0);
+                    if (i > m + 2)
+                        h(i, i - 3) = T(0);
+                }
+
+                // chase the bulge down rows l..n and columns m..n with 3x3 householder reflections
+                for (ptrdiff_t k = m; k <= n - 1; ++k)
+                {
+                    const bool notlast = k != n - 1;
+                    if (k != m)
+                    {
+                        p = h(k, k - 1);
+                        q = h(k + 1, k - 1);
+                        r = notlast ? h(k + 2, k - 1) : T(0);
+                        x = std::abs(p) + std::abs(q) + std::abs(r);
+                        if (x == T(0))
+                            continue;
+                        p /= x;
+                        q /= x;
+                        r /= x;
+                    }
+
+                    s = std::sqrt(p * p + q * q + r * r);
+                    if (p < T(0))
+                        s = -s;
+                    if (s == T(0))
+                        continue;
+
+                    if (k != m)
+                        h(k, k - 1) = -s * x;
+                    else if (l != m)
+                        h(k, k - 1) = -h(k, k - 1);
+                    p += s;
+                    x = p / s;
+                    y = q / s;
+                    z = r / s;
+                    q /= p;
+                    r /= p;
+
+                    for (size_t j = k; j < row_end(n); ++j)
+                    {
+                        p = h(k, j) + q * h(k + 1, j);
+                        if (notlast)
+                        {
+                            p += r * h(k + 2, j);
+                            h(k + 2, j) -= p * z;
+                        }
+                        h(k, j) -= p * x;
+                        h(k + 1, j) -= p * y;
+                    }
+                    for (size_t i = column_begin(l); i <= size_t(std::min(n, k + 3)); ++i)
+                    {
+                        p = x * h(i, k) + y * h(i, k + 1);
+                        if (notlast)
+                        {
+                            p += z * h(i, k + 2);
+                            h(i, k + 2) -= p * r;
+                        }
+                        h(i, k) -= p;
+                        h(i, k + 1) -= p * q;
+                    }
+                    if (with_vectors)
+                    {
+                        for (size_t i = 0; i < nn; ++i)
+                        {
+                            p = x * v(i, k) + y * v(i, k + 1);
+                            if (notlast)
+                            {
+                                p += z * v(i, k + 2);
+                                v(i, k + 2) -= p * r;
+                            }
+                            v(i, k) -= p;
+                            v(i, k + 1) -= p * q;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // (xr + i xi) / (yr + i yi) without overflowing the intermediate products
+    static void cdiv(T xr, T xi, T yr, T yi, T& zr, T& zi)
+    {
+        if (std::abs(yr) > std::abs(yi))
+        {
+            const T r = yi / yr, den = yr + r * yi;
+            zr = (xr + r * xi) / den;
+            zi = (xi - r * xr) / den;
+        }
+        else
+        {
+            const T r = yr / yi, den = yi + r * yr;
+            zr = (r * xr + xi) / den;
+            zi = (r * xi - xr) / den;
+        }
+    }
+
+    // eigenvectors of the quasi triangular h, then mapped back through v
+    void back_substitute()
+    {
+        const T eps = std::numeric_limits<T>::epsilon();
+        T norm = T(0);
+        for (size_t i = 0; i < nn; ++i)
+            for (size_t j = i ? i - 1 : 0; j < nn; ++j)
+                norm += std::abs(h(i, j));
+        if (norm == T(0))
+            return;
+
+        T p, q, r = 0, s = 0, t, w, x, y, z = 0;
+        for (ptrdiff_t n = ptrdiff_t(nn) - 1; n >= 0; --n)
+        {
+            p = d[n];
+            q = e[n];
+
+            if (q == T(0))
+            {
+                // real vector
+                ptrdiff_t l = n;
+                h(n, n) = T(1);
+                for (ptrdiff_t i = n - 1; i >= 0; --i)
+                {
+                    w = h(i, i) - p;
+                    r = T(0);
+                    for (ptrdiff_t j = l; j <= n; ++j)
+                        r += h(i, j) * h(j, n);
+                    if (e[i] < T(0))
+                    {
+                        z = w;
+                        s = r;
+                        continue;
+                    }
+                    l = i;
+                    if (e[i] == T(0))
+                    {
+                        h(i, n) = w != T(0) ? -r / w : -r / (eps * norm);
+                    }
+                    else
+                    {
+                        x = h(i, i + 1);
+                        y = h(i + 1, i);
+                        q = (d[i] - p) * (d[i] - p) + e[i] * e[i];
+                        t = (x * s - z * r) / q;
+                        h(i, n) = t;
+                        h(i + 1, n) = std::abs(x) > std::abs(z) ? (-r - w * t) / x : (-s - y * t) / z;
+                    }
+
+                    t = std::abs(h(i, n));
+                    if ((eps * t) * t > T(1))
+                        for (ptrdiff_t j = i; j <= n; ++j)
+                            h(j, n) /= t;
+                }
+            }
+            else if (q < T(0))
+            {
+                // complex vector, real part in column n - 1 and imaginary part in column n
+                ptrdiff_t l = n - 1;
+                if (std::abs(h(n, n - 1)) > std::abs(h(n - 1, n)))
+                {
+                    h(n - 1, n - 1) = q / h(n, n - 1);
+                    h(n - 1, n) = -(h(n, n) - p) / h(n, n - 1);
+                }
+                else
+                {
+                    cdiv(T(0), -h(n - 1, n), h(n - 1, n - 1) - p, q, h(n - 1, n - 1), h(n - 1, n));
+                }
+                h(n, n - 1) = T(0);
+                h(n, n) = T(1);
+                for (ptrdiff_t i = n - 2; i >= 0; --i)
+                {
+                    T ra = T(0), sa = T(0);
+                    for (ptrdiff_t j = l; j <= n; ++j)
+                    {
+                        ra += h(i, j) * h(j, n - 1);
+                        sa += h(i, j) * h(j, n);
+                    }
+                    w = h(i, i) - p;
+
+                    if (e[i] < T(0))
+                    {
+                        z = w;
+                        r = ra;
+                        s = sa;
+                        continue;
+                    }
+                    l = i;
+                    if (e[i] == T(0))
+                    {
+                        cdiv(-ra, -sa, w, q, h(i, n - 1), h(i, n));
+                    }
+                    else
+                    {
+                        x = h(i, i + 1);
+                        y = h(i + 1, i);
+                        T vr = (d[i] - p) * (d[i] - p) + e[i] * e[i] - q * q;
+                        const T vi = (d[i] - p) * T(2) * q;
+                        if (vr == T(0) && vi == T(0))
+                            vr = eps * norm * (std::abs(w) + std::abs(q) + std::abs(x) + std::abs(y) + std::abs(z));
+                        cdiv(x * r - z * ra + q * sa, x * s - z * sa - q * ra, vr, vi, h(i, n - 1), h(i, n));
+                        if (std::abs(x) > std::abs(z) + std::abs(q))
+                        {
+                            h(i + 1, n - 1) = (-ra - w * h(i, n - 1) + q * h(i, n)) / x;
+                            h(i + 1, n) = (-sa - w * h(i, n) - q * h(i, n - 1)) / x;
+                        }
+                        else
+                        {
+                            cdiv(-r - y * h(i, n - 1), -s - y * h(i, n), z, q, h(i + 1, n - 1), h(i + 1, n));
+                        }
+                    }
+
+                    t = std::max(std::abs(h(i, n - 1)), std::abs(h(i, n)));
+                    if ((eps * t) * t > T(1))
+                    {
+                        for (ptrdiff_t j = i; j <= n; ++j)
+                        {
+                            h(j, n - 1) /= t;
+                            h(j, n) /= t;
+                        }
+                    }
+                }
+            }
+        }
+
+        // v = v h over the upper triangle of h, from the last column so each column is read before it is written
+        for (size_t j = nn; j-- > 0;)
+        {
+            for (size_t i = 0; i < nn; ++i)
+            {
+                T sum = T(0);
+                for (size_t k = 0; k <= j; ++k)
+                    sum += v(i, k) * h(k, j);
+                v(i, j) = sum;
+            }
+        }
+    }
+};
+
+}
+
+// eigenvalues, and with vectors the eigenvectors, of a real square matrix
+// without convergence after 30 n qr iterations stats.converged is false and values is empty
+template<class T>
+eigen_decomposition<T> eigen(dyn_mat<T> const& m, bool vectors = false)
+{
+    detail::francis_qr<T> qr(m, vectors);
+    eigen_decomposition<T> res;
+    res.stats = qr.stats;
+    if (!qr.stats.converged)
+        return res;
+
+    const size_t n = m.rows;
+    res.values.reserve(n);
+    for (size_t j = 0; j < n; ++j)
+        res.values.push_back(complex<T>(qr.d[j], qr.e[j]));
+
+    if (vectors)
+    {
+        res.vectors = dyn_mat<complex<T>>(n, n);
+        for (size_t j = 0; j < n; ++j)
+        {
+            if (qr.e[j] == T(0))
+            {
+                for (size_t i = 0; i < n; ++i)
+                    res.vectors(i, j) = complex<T>(qr.v(i, j), T(0));
+            }
+            else if (qr.e[j] > T(0))
+            {
+                // the pair shares columns j and j + 1 of v as real and imaginary part
+                for (size_t i = 0; i < n; ++i)
+                {
+                    res.vectors(i, j) = complex<T>(qr.v(i, j), qr.v(i, j + 1));
+                    res.vectors(i, j + 1) = complex<T>(qr.v(i, j), -qr.v(i, j + 1));
+                }
+            }
+        }
+    }
+    return res;
+}
+
+template<class T, int N>
+eigen_decomposition<T> eigen(mat<T, N, N> const& m, bool vectors = false)
+{
+    return eigen(dyn_mat<T>(m), vectors);
+}
+
+}
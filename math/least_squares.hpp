@@ -0,0 +1,499 @@
+#pragma once
+
+#include <dyn_mat.hpp>
+
+#include <cmath>
+
+namespace er
+{
+
+namespace detail
+{
+
+template<class T>
+T row_dot(T const* x, T const* y, size_t n)
+{
+    T s = T(0);
+    for (size_t i = 0; i < n; ++i)
+        s += x[i] * y[i];
+    return s;
+}
+
+// y[0..n) += a x[0..n)
+template<class T>
+void row_axpy(T* y, T const* x, T const& a, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        y[i] += a * x[i];
+}
+
+// the householder reflector I - tau v v^T with v[0] = 1 that maps (alpha, x) to (beta, 0), as lapack's dlarfg
+// alpha becomes beta and x becomes the rest of v, a zero x gives tau = 0 and leaves both alone
+template<class T>
+T householder(T& alpha, T* x, size_t stride, size_t n)
+{
+    T sq = T(0);
+    for (size_t i = 0; i < n; ++i)
+        sq += x[i * stride] * x[i * stride];
+    if (sq == T(0))
+        return T(0);
+    const T norm = std::sqrt(alpha * alpha + sq);
+    const T beta = alpha < T(0) ? norm : -norm;
+    const T tau = (beta - alpha) / beta, scale = T(1) / (alpha - beta);
+    for (size_t i = 0; i < n; ++i)
+        x[i * stride] *= scale;
+    alpha = beta;
+    return tau;
+}
+
+}
+
+// m = q r by householder reflections, for any shape
+// qr holds r on and above its diagonal and the reflectors' vectors below it, their leading 1 left out,
+// q is the product of the reflectors I - tau[j] v_j v_j^T
+// a zero on the diagonal of r marks the factorization rank deficient, solve returns {} then
+// everything lives in the object, so no allocation
+template<class T, int R, int C>
+struct qr_factorization
+{
+    ER_STATIC_CONSTEXPR int K = min_v<R, C>;
+
+    mat<T, R, C> qr;
+    std::array<T, K> tau = {};
+    bool rank_deficient = false;
+
+    explicit qr_factorization(mat<T, R, C> const& m) : qr(m)
+    {
+        for (int j = 0; j < K; ++j)
+        {
+            T* col = qr.ptr() + j * C + j;
+            tau[j] = detail::householder(*col, col + C, C, R - j - 1);
+            if (qr(j, j) == T(0))
+                rank_deficient = true;
+            // the columns to the right, w = v^T a then a -= tau v w
+            for (int c = j + 1; c < C && tau[j] != T(0); ++c)
+            {
+                T w = qr(j, c);
+                for (int i = j + 1; i < R; ++i)
+                    w += qr(i, j) * qr(i, c);
+                w *= tau[j];
+                qr(j, c) -= w;
+                for (int i = j + 1; i < R; ++i)
+                    qr(i, c) -= w * qr(i, j);
+            }
+        }
+    }
+
+    // q^T b
+    template<int M>
+    mat<T, R, M> apply_qt(mat<T, R, M> b) const
+    {
+        for (int j = 0; j < K; ++j)
+        {
+            if (tau[j] == T(0))
+                continue;
+            for (int c = 0; c < M; ++c)
+            {
+                T w = b(j, c);
+                for (int i = j + 1; i < R; ++i)
+                    w += qr(i, j) * b(i, c);
+                w *= tau[j];
+                b(j, c) -= w;
+                for (int i = j + 1; i < R; ++i)
+                    b(i, c) -= w * qr(i, j);
+            }
+        }
+        return b;
+    }
+
+    // x minimizing |m x - b| for every column of b, the solution of m x = b when m is square
+    template<int M>
+    mat<T, C, M> solve(mat<T, R, M> const& b) const requires (R >= C)
+    {
+        if (rank_deficient)
+            return {};
+        const auto y = apply_qt(b);
+        mat<T, C, M> x;
+        for (int i = C - 1; i >= 0; --i)
+        {
+            for (int c = 0; c < M; ++c)
+            {
+                T s = y(i, c);
+                for (int k = i + 1; k < C; ++k)
+                    s -= qr(i, k) * x(k, c);
+                x(i, c) = s / qr(i, i);
+            }
+        }
+        return x;
+    }
+
+    // the leading K columns of q
+    mat<T, R, K> q() const
+    {
+        mat<T, R, K> res;
+        for (int i = 0; i < K; ++i)
+            res(i, i) = T(1);
+        for (int j = K - 1; j >= 0; --j)
+        {
+            if (tau[j] == T(0))
+                continue;
+            for (int c = j; c < K; ++c)
+            {
+                T w = res(j, c);
+                for (int i = j + 1; i < R; ++i)
+                    w += qr(i, j) * res(i, c);
+                w *= tau[j];
+                res(j, c) -= w;
+                for (int i = j + 1; i < R; ++i)
+                    res(i, c) -= w * qr(i, j);
+            }
+        }
+        return res;
+    }
+
+    mat<T, K, C> r() const
+    {
+        mat<T, K, C> res;
+        for (int i = 0; i < K; ++i)
+            for (int j = i; j < C; ++j)
+                res(i, j) = qr(i, j);
+        return res;
+    }
+};
+
+// m = l l^T for a symmetric positive definite m, only the lower triangle of m is read
+// a pivot that is not positive marks m indefinite, solve returns {} then
+template<class T, int N>
+struct cholesky_factorization
+{
+    mat<T, N, N> l;
+    bool indefinite = false;
+
+    explicit cholesky_factorization(mat<T, N, N> const& m)
+    {
+        for (int j = 0; j < N; ++j)
+        {
+            T d = m(j, j);
+            for (int k = 0; k < j; ++k)
+                d -= l(j, k) * l(j, k);
+            if (!(d > T(0)))
+            {
+                indefinite = true;
+                return;
+            }
+            l(j, j) = std::sqrt(d);
+            for (int i = j + 1; i < N; ++i)
+            {
+                T s = m(i, j);
+                for (int k = 0; k < j; ++k)
+                    s -= l(i, k) * l(j, k);
+                l(i, j) = s / l(j, j);
+            }
+        }
+    }
+
+    // x with m x = b for every column of b
+    template<int M>
+    mat<T, N, M> solve(mat<T, N, M> const& b) const
+    {
+        if (indefinite)
+            return {};
+        mat<T, N, M> x;
+        for (int i = 0; i < N; ++i)
+        {
+            for (int c = 0; c < M; ++c)
+            {
+                T s = b(i, c);
+                for (int k = 0; k < i; ++k)
+                    s -= l(i, k) * x(k, c);
+                x(i, c) = s / l(i, i);
+            }
+        }
+        for (int i = N - 1; i >= 0; --i)
+        {
+            for (int c = 0; c < M; ++c)
+            {
+                T s = x(i, c);
+                for (int k = i + 1; k < N; ++k)
+                    s -= l(k, i) * x(k, c);
+                x(i, c) = s / l(i, i);
+            }
+        }
+        return x;
+    }
+
+    T determinant() const
+    {
+        if (indefinite)
+            return T(0);
+        T det = T(1);
+        for (int i = 0; i < N; ++i)
+            det *= l(i, i) * l(i, i);
+        return det;
+    }
+};
+
+// qr_factorization for a dyn_mat
+// reflectors are made in panels of block columns and applied to the rest of the matrix at once
+// in the compact wy form I - v t v^T of Schreiber and Van Loan, as two gemms per panel
+template<class T>
+struct dyn_qr_factorization
+{
+    ER_STATIC_CONSTEXPR size_t block = 32;
+
+    dyn_mat<T> qr;
+    std::vector<T> tau;
+    bool rank_deficient = false;
+
+    explicit dyn_qr_factorization(dyn_mat<T> const& m) : qr(m), tau(std::min(m.rows, m.cols))
+    {
+        const size_t rows = qr.rows, cols = qr.cols, k = tau.size();
+        // the panel's reflectors one after the other and as the columns of v, t, and w = v^T times the trailing columns
+        std::vector<T> v, vt, t(block * block), w;
+        for (size_t j0 = 0; j0 < k; j0 += block)
+        {
+            const size_t j1 = std::min(j0 + block, k), nb = j1 - j0, h = rows - j0, rest = cols - j1;
+            factor_panel(j0, j1, vt);
+            if (!rest)
+                continue;
+
+            v.resize(h * nb);
+            for (size_t j = 0; j < nb; ++j)
+            {
+                T* vj = vt.data() + j * h;
+                std::fill(vj, vj + j, T(0));
+                vj[j] = T(1);
+                for (size_t i = 0; i < h; ++i)
+                    v[i * nb + j] = vj[i];
+            }
+
+            // t upper triangular with column i = -tau_i t v^T v_i above its diagonal, as lapack's dlarft
+            for (size_t i = 0; i < nb; ++i)
+            {
+                T* ti = t.data() + i;
+                for (size_t l = 0; l < i; ++l)
+                    ti[l * block] = -tau[j0 + i] * detail::row_dot(vt.data() + l * h, vt.data() + i * h, h);
+                for (size_t l = 0; l < i; ++l)
+                {
+                    T s = T(0);
+                    for (size_t p = l; p < i; ++p)
+                        s += t[l * block + p] * ti[p * block];
+                    ti[l * block] = s;
+                }
+                ti[i * block] = tau[j0 + i];
+            }
+
+            // a -= v t^T (v^T a) on the trailing columns, q^T being the transpose of I - v t v^T
+            T* a = qr.data.data() + j0 * cols + j1;
+            w.assign(nb * rest, T(0));
+            detail::gemm_blocked<detail::gemm_lanes<T>>(nb, rest, h, T(1), vt.data(), h, a, cols, w.data(), rest);
+            for (size_t i = nb; i-- > 0;)
+            {
+                T* wi = w.data() + i * rest;
+                for (size_t c = 0; c < rest; ++c)
+                    wi[c] *= t[i * block + i];
+                for (size_t l = 0; l < i; ++l)
+                    detail::row_axpy(wi, w.data() + l * rest, t[l * block + i], rest);
+            }
+            detail::gemm_blocked<detail::gemm_lanes<T>>(h, rest, nb, T(-1), v.data(), nb, w.data(), rest, a, cols);
+        }
+    }
+
+    // q^T b, reflector by reflector along the rows of b
+    dyn_mat<T> apply_qt(dyn_mat<T> b) const
+    {
+        assert(b.rows == qr.rows);
+        std::vector<T> w(b.cols);
+        for (size_t j = 0; j < tau.size(); ++j)
+            reflect(b, j, w);
+        return b;
+    }
+
+    // x minimizing |m x - b| for every column of b, the solution of m x = b when m is square
+    dyn_mat<T> solve(dyn_mat<T> const& b) const
+    {
+        assert(qr.rows >= qr.cols);
+        if (rank_deficient)
+            return {};
+        const size_t n = qr.cols, k = b.cols;
+        const auto y = apply_qt(b);
+        dyn_mat<T> x(n, k);
+        for (size_t i = n; i-- > 0;)
+        {
+            std::copy(y[i], y[i] + k, x[i]);
+            for (size_t j = i + 1; j < n; ++j)
+                detail::row_axpy(x[i], x[j], -qr(i, j), k);
+            for (size_t c = 0; c < k; ++c)
+                x(i, c) /= qr(i, i);
+        }
+        return x;
+    }
+
+    // the leading min(rows, cols) columns of q
+    dyn_mat<T> q() const
+    {
+        const size_t k = tau.size();
+        dyn_mat<T> res(qr.rows, k);
+        for (size_t i = 0; i < k; ++i)
+            res(i, i) = T(1);
+        std::vector<T> w(k);
+        for (size_t j = k; j-- > 0;)
+            reflect(res, j, w);
+        return res;
+    }
+
+    dyn_mat<T> r() const
+    {
+        dyn_mat<T> res(tau.size(), qr.cols);
+        for (size_t i = 0; i < res.rows; ++i)
+            std::copy(qr[i] + i, qr[i] + qr.cols, res[i] + i);
+        return res;
+    }
+
+private:
+    // b = (I - tau v v^T) b for reflector j, w = v^T b
+    void reflect(dyn_mat<T>& b, size_t j, std::vector<T>& w) const
+    {
+        if (tau[j] == T(0))
+            return;
+        std::copy(b[j], b[j] + b.cols, w.begin());
+        for (size_t i = j + 1; i < qr.rows; ++i)
+            detail::row_axpy(w.data(), b[i], qr(i, j), b.cols);
+        detail::row_axpy(b[j], w.data(), -tau[j], b.cols);
+        for (size_t i = j + 1; i < qr.rows; ++i)
+            detail::row_axpy(b[i], w.data(), -tau[j] * qr(i, j), b.cols);
+    }
+
+    // unblocked reflectors for columns [j0, j1), applied to the rest of the panel only
+    // the panel is worked on as contiguous columns in p, which keeps them for the caller
+    void factor_panel(size_t j0, size_t j1, std::vector<T>& p)
+    {
+        const size_t h = qr.rows - j0, nb = j1 - j0;
+        p.resize(nb * h);
+        for (size_t i = 0; i < h; ++i)
+            for (size_t j = 0; j < nb; ++j)
+                p[j * h + i] = qr(j0 + i, j0 + j);
+
+        for (size_t j = 0; j < nb; ++j)
+        {
+            T* col = p.data() + j * h;
+            const size_t n = h - j - 1;
+            tau[j0 + j] = detail::householder(col[j], col + j + 1, 1, n);
+            if (col[j] == T(0))
+                rank_deficient = true;
+            if (tau[j0 + j] == T(0))
+                continue;
+            for (size_t c = j + 1; c < nb; ++c)
+            {
+                T* other = p.data() + c * h;
+                const T w = tau[j0 + j] * (other[j] + detail::row_dot(col + j + 1, other + j + 1, n));
+                other[j] -= w;
+                detail::row_axpy(other + j + 1, col + j + 1, -w, n);
+            }
+        }
+
+        for (size_t i = 0; i < h; ++i)
+            for (size_t j = 0; j < nb; ++j)
+                qr(j0 + i, j0 + j) = p[j * h + i];
+    }
+};
+
+// cholesky_factorization for a dyn_mat, right looking in panels of block columns,
+// the trailing matrix is updated with one gemm per panel
+template<class T>
+struct dyn_cholesky_factorization
+{
+    ER_STATIC_CONSTEXPR size_t block = 64;
+
+    dyn_mat<T> l;
+    bool indefinite = false;
+
+    explicit dyn_cholesky_factorization(dyn_mat<T> const& m) : l(m)
+    {
+        assert(m.rows == m.cols);
+        const size_t n = l.rows;
+        std::vector<T> lt;
+        for (size_t j0 = 0; j0 < n && !indefinite; j0 += block)
+        {
+            const size_t j1 = std::min(j0 + block, n), nb = j1 - j0, rest = n - j1;
+            // the diagonal block, then the rows below it against its transpose
+            for (size_t j = j0; j < j1; ++j)
+            {
+                const T d = l(j, j) - detail::row_dot(l[j] + j0, l[j] + j0, j - j0);
+                if (!(d > T(0)))
+                {
+                    indefinite = true;
+                    break;
+                }
+                l(j, j) = std::sqrt(d);
+                for (size_t i = j + 1; i < n; ++i)
+                    l(i, j) = (l(i, j) - detail::row_dot(l[i] + j0, l[j] + j0, j - j0)) / l(j, j);
+            }
+            if (indefinite || !rest)
+                continue;
+
+            // a22 -= l21 l21^T, the upper triangle too since gemm has no triangular form
+            lt.assign(nb * rest, T(0));
+            for (size_t i = 0; i < rest; ++i)
+                for (size_t j = 0; j < nb; ++j)
+                    lt[j * rest + i] = l(j1 + i, j0 + j);
+            T* a = l.data.data();
+            detail::gemm_blocked<detail::gemm_lanes<T>>(rest, rest, nb, T(-1), a + j1 * n + j0, n, lt.data(), rest, a + j1 * n + j1, n);
+        }
+        for (size_t i = 0; i < n; ++i)
+            std::fill(l[i] + i + 1, l[i] + n, T(0));
+    }
+
+    // x with m x = b for every column of b
+    dyn_mat<T> solve(dyn_mat<T> const& b) const
+    {
+        assert(b.rows == l.rows);
+        if (indefinite)
+            return {};
+        const size_t n = l.rows, k = b.cols;
+        dyn_mat<T> x = b;
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < i; ++j)
+                detail::row_axpy(x[i], x[j], -l(i, j), k);
+            for (size_t c = 0; c < k; ++c)
+                x(i, c) /= l(i, i);
+        }
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t c = 0; c < k; ++c)
+                x(i, c) /= l(i, i);
+            for (size_t j = 0; j < i; ++j)
+                detail::row_axpy(x[j], x[i], -l(i, j), k);
+        }
+        return x;
+    }
+
+    T determinant() const
+    {
+        if (indefinite)
+            return T(0);
+        T det = T(1);
+        for (size_t i = 0; i < l.rows; ++i)
+            det *= l(i, i) * l(i, i);
+        return det;
+    }
+};
+
+// x minimizing |a x - b| for every column of b by householder qr, for a with at least as many rows as columns
+// unlike the normal equations a^T a x = a^T b this does not square the condition of a
+// a rank deficient a gives {}
+template<class T, int R, int C, int M> requires (R >= C)
+mat<T, C, M> least_squares(mat<T, R, C> const& a, mat<T, R, M> const& b)
+{
+    return qr_factorization<T, R, C>(a).solve(b);
+}
+
+template<class T>
+dyn_mat<T> least_squares(dyn_mat<T> const& a, dyn_mat<T> const& b)
+{
+    assert(a.rows >= a.cols && a.rows == b.rows);
+    return dyn_qr_factorization<T>(a).solve(b);
+}
+
+}
@@ -0,0 +1,478 @@
+#pragma once
+
+#include <vec.hpp>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+namespace er
+{
+
+namespace detail
+{
+
+// one 64 byte line of scalars, an avx-512 register or two avx2 ones per element
+template<class T>
+ER_STATIC_CONSTEXPR int batch_width = sizeof(T) < 64 ? int(64 / sizeof(T)) : 1;
+
+// what mat_batch needs of a vector of lanes, a mask picks lanes where a comparison held
+template<class T>
+struct scalar_mat_lanes
+{
+    using reg = T;
+    using mask = bool;
+    ER_STATIC_CONSTEXPR int width = 1;
+
+    static reg load(T const* p) { return *p; }
+    static void store(T* p, reg v) { *p = v; }
+    static reg set1(T x) { return x; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg div(reg a, reg b) { return a / b; }
+    static reg mul_add(reg a, reg b, reg c) { return a * b + c; }
+    static reg mul_sub(reg a, reg b, reg c) { return c - a * b; }
+    static reg magnitude(reg a) { return reg(pivot_magnitude(a)); }
+    static mask greater(reg a, reg b) { return a > b; }
+    static mask equal(reg a, reg b) { return a == b; }
+    static reg select(mask m, reg a, reg b) { return m ? a : b; }
+};
+
+#if defined(__AVX512F__)
+template<class T>
+struct avx512_mat_lanes;
+
+template<>
+struct avx512_mat_lanes<f32>
+{
+    using reg = __m512;
+    using mask = __mmask16;
+    ER_STATIC_CONSTEXPR int width = 16;
+
+    static reg load(f32 const* p) { return _mm512_loadu_ps(p); }
+    static void store(f32* p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg set1(f32 x) { return _mm512_set1_ps(x); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    static reg mul_sub(reg a, reg b, reg c) { return _mm512_fnmadd_ps(a, b, c); }
+    static reg magnitude(reg a) { return _mm512_abs_ps(a); }
+    static mask greater(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static mask equal(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+};
+
+template<>
+struct avx512_mat_lanes<f64>
+{
+    using reg = __m512d;
+    using mask = __mmask8;
+    ER_STATIC_CONSTEXPR int width = 8;
+
+    static reg load(f64 const* p) { return _mm512_loadu_pd(p); }
+    static void store(f64* p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg set1(f64 x) { return _mm512_set1_pd(x); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+    static reg mul_sub(reg a, reg b, reg c) { return _mm512_fnmadd_pd(a, b, c); }
+    static reg magnitude(reg a) { return _mm512_abs_pd(a); }
+    static mask greater(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static mask equal(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+    static reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+};
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+template<class T>
+struct avx2_mat_lanes;
+
+template<>
+struct avx2_mat_lanes<f32>
+{
+    using reg = __m256;
+    using mask = __m256;
+    ER_STATIC_CONSTEXPR int width = 8;
+
+    static reg load(f32 const* p) { return _mm256_loadu_ps(p); }
+    static void store(f32* p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(f32 x) { return _mm256_set1_ps(x); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static reg mul_sub(reg a, reg b, reg c) { return _mm256_fnmadd_ps(a, b, c); }
+    static reg magnitude(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static mask greater(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static mask equal(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+};
+
+template<>
+struct avx2_mat_lanes<f64>
+{
+    using reg = __m256d;
+    using mask = __m256d;
+    ER_STATIC_CONSTEXPR int width = 4;
+
+    static reg load(f64 const* p) { return _mm256_loadu_pd(p); }
+    static void store(f64* p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(f64 x) { return _mm256_set1_pd(x); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    static reg mul_add(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    static reg mul_sub(reg a, reg b, reg c) { return _mm256_fnmadd_pd(a, b, c); }
+    static reg magnitude(reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static mask greater(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static mask equal(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+    static reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+};
+#endif
+
+// widest lanes the target was compiled for, e.g. -mavx2 -mfma or -march=native
+template<class T>
+struct mat_lanes_of { using type = scalar_mat_lanes<T>; };
+
+#if defined(__AVX512F__)
+template<> struct mat_lanes_of<f32> { using type = avx512_mat_lanes<f32>; };
+template<> struct mat_lanes_of<f64> { using type = avx512_mat_lanes<f64>; };
+#elif defined(__AVX2__) && defined(__FMA__)
+template<> struct mat_lanes_of<f32> { using type = avx2_mat_lanes<f32>; };
+template<> struct mat_lanes_of<f64> { using type = avx2_mat_lanes<f64>; };
+#endif
+
+// a lane count the vector width does not divide falls back to scalars
+template<class T, int Lanes>
+using mat_lanes = std::conditional_t<Lanes % mat_lanes_of<T>::type::width == 0, typename mat_lanes_of<T>::type, scalar_mat_lanes<T>>;
+
+}
+
+template<class T, int N, int Lanes>
+struct mat_batch_lu;
+
+// Lanes matrices of one shape stored element major: element (i, j) of matrix l is data[i][j][l],
+// so one element of consecutive matrices fills a vector register and every op runs on all of them at once.
+// nothing branches on values, pivoting is a per lane select
+template<class T, int R, int C, int Lanes = detail::batch_width<T>>
+struct mat_batch
+{
+    ER_STATIC_CONSTEXPR bool is_square = R == C;
+    using lanes_t = std::array<T, Lanes>;
+    using V = detail::mat_lanes<T, Lanes>;
+
+    alignas(64) T data[R][C][Lanes];
+
+    mat_batch() : data{} {}
+
+    // count matrices from m, the remaining lanes hold the identity when square and zero otherwise
+    explicit mat_batch(mat<T, R, C> const* m, int count = Lanes) : data{}
+    {
+        assert(0 <= count && count <= Lanes);
+        for (int l = 0; l < count; ++l)
+            set(l, m[l]);
+        if constexpr (is_square)
+            for (int l = count; l < Lanes; ++l)
+                for (int i = 0; i < R; ++i)
+                    data[i][i][l] = T(1);
+    }
+
+    static mat_batch identity() requires (is_square)
+    {
+        mat_batch result;
+        for (int i = 0; i < R; ++i)
+            for (int l = 0; l < Lanes; ++l)
+                result.data[i][i][l] = T(1);
+        return result;
+    }
+
+    // the first count matrices to m
+    void store(mat<T, R, C>* m, int count = Lanes) const
+    {
+        assert(0 <= count && count <= Lanes);
+        for (int l = 0; l < count; ++l)
+            m[l] = get(l);
+    }
+
+    void set(int l, mat<T, R, C> const& m)
+    {
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                data[i][j][l] = m.raw_data[i][j];
+    }
+
+    mat<T, R, C> get(int l) const
+    {
+        mat<T, R, C> m;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                m.raw_data[i][j] = data[i][j][l];
+        return m;
+    }
+
+    // element (i, j) of every matrix
+    T* operator()(int i, int j) { return data[i][j]; }
+    T const* operator()(int i, int j) const { return data[i][j]; }
+
+    template<class F>
+    friend mat_batch element_wise(mat_batch const& x, mat_batch const& y, F&& f)
+    {
+        mat_batch result;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                for (int l = 0; l < Lanes; ++l)
+                    result.data[i][j][l] = f(x.data[i][j][l], y.data[i][j][l]);
+        return result;
+    }
+
+    friend mat_batch operator+(mat_batch const& x, mat_batch const& y) { return lane_wise(x, y, [](auto a, auto b) { return V::add(a, b); }); }
+    friend mat_batch operator-(mat_batch const& x, mat_batch const& y) { return lane_wise(x, y, [](auto a, auto b) { return V::sub(a, b); }); }
+    friend mat_batch comp_mul(mat_batch const& x, mat_batch const& y) { return lane_wise(x, y, [](auto a, auto b) { return V::mul(a, b); }); }
+
+    friend mat_batch operator*(mat_batch const& x, T const& y)
+    {
+        const auto s = V::set1(y);
+        mat_batch result;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                for (int l = 0; l < Lanes; l += V::width)
+                    V::store(result.data[i][j] + l, V::mul(V::load(x.data[i][j] + l), s));
+        return result;
+    }
+
+    friend mat_batch operator*(T const& x, mat_batch const& y) { return y * x; }
+
+    template<int M>
+    friend mat_batch<T, R, M, Lanes> operator*(mat_batch const& x, mat_batch<T, C, M, Lanes> const& y)
+    {
+        mat_batch<T, R, M, Lanes> result;
+        for (int l = 0; l < Lanes; l += V::width)
+        {
+            for (int i = 0; i < R; ++i)
+            {
+                for (int j = 0; j < M; ++j)
+                {
+                    auto s = V::mul(V::load(x.data[i][0] + l), V::load(y.data[0][j] + l));
+                    for (int k = 1; k < C; ++k)
+                        s = V::mul_add(V::load(x.data[i][k] + l), V::load(y.data[k][j] + l), s);
+                    V::store(result.data[i][j] + l, s);
+                }
+            }
+        }
+        return result;
+    }
+
+    friend mat_batch<T, C, R, Lanes> transpose(mat_batch const& m)
+    {
+        mat_batch<T, C, R, Lanes> result;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                for (int l = 0; l < Lanes; ++l)
+                    result.data[j][i][l] = m.data[i][j][l];
+        return result;
+    }
+
+    friend bool operator==(mat_batch const& x, mat_batch const& y)
+    {
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                for (int l = 0; l < Lanes; ++l)
+                    if (x.data[i][j][l] != y.data[i][j][l])
+                        return false;
+        return true;
+    }
+
+    // closed forms up to 3x3 like mat's determinant, an lu beyond
+    friend lanes_t determinant(mat_batch const& m) requires (is_square)
+    {
+        if constexpr (R > 3)
+            return mat_batch_lu<T, R, Lanes>(m).determinant();
+        lanes_t det;
+        auto const& a = m.data;
+        for (int l = 0; l < Lanes; l += V::width)
+        {
+            auto e = [&](int i, int j) { return V::load(a[i][j] + l); };
+            auto cross = [&](int i, int j, int k, int n) { return V::mul_sub(e(i, n), e(j, k), V::mul(e(i, k), e(j, n))); };
+            if constexpr (1 == R)
+                V::store(det.data() + l, e(0, 0));
+            else if constexpr (2 == R)
+                V::store(det.data() + l, cross(0, 1, 0, 1));
+            else if constexpr (3 == R)
+                V::store(det.data() + l, V::mul_add(e(0, 2), cross(1, 2, 0, 1),
+                    V::mul_sub(e(0, 1), cross(1, 2, 0, 2), V::mul(e(0, 0), cross(1, 2, 1, 2)))));
+        }
+        return det;
+    }
+
+    // like mat's inverse, singular lanes come back zero
+    friend mat_batch inverse(mat_batch const& m) requires (is_square)
+    {
+        return mat_batch_lu<T, R, Lanes>(m).inverse();
+    }
+
+    // x with m x = b in every lane, zero in singular lanes
+    template<int M>
+    friend mat_batch<T, R, M, Lanes> solve(mat_batch const& m, mat_batch<T, R, M, Lanes> const& b) requires (is_square)
+    {
+        return mat_batch_lu<T, R, Lanes>(m).solve(b);
+    }
+
+private:
+    template<class F>
+    static mat_batch lane_wise(mat_batch const& x, mat_batch const& y, F&& f)
+    {
+        mat_batch result;
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                for (int l = 0; l < Lanes; l += V::width)
+                    V::store(result.data[i][j] + l, f(V::load(x.data[i][j] + l), V::load(y.data[i][j] + l)));
+        return result;
+    }
+};
+
+// lu_factorization of every lane, the pivot row of each lane chosen by a select rather than a branch
+// pivot[j] holds the row swapped with row j at step j as a T, so the swaps are selects on T lanes too.
+// a lane whose pivot is zero is marked singular and continues with pivot one so it stays finite
+template<class T, int N, int Lanes = detail::batch_width<T>>
+struct mat_batch_lu
+{
+    using lanes_t = std::array<T, Lanes>;
+    using V = detail::mat_lanes<T, Lanes>;
+
+    mat_batch<T, N, N, Lanes> lu;
+    alignas(64) T pivot[N][Lanes];
+    // 1 / u(i, i), and the sign of the permutation or zero where singular
+    alignas(64) T reciprocal[N][Lanes];
+    alignas(64) T sign[Lanes];
+    std::array<bool, Lanes> singular{};
+
+    explicit mat_batch_lu(mat_batch<T, N, N, Lanes> const& m) : lu(m)
+    {
+        auto& a = lu.data;
+        const auto zero = V::set1(T(0)), one = V::set1(T(1));
+        for (int l = 0; l < Lanes; l += V::width)
+        {
+            auto e = [&](int i, int j) { return V::load(a[i][j] + l); };
+            auto s = one;
+            for (int j = 0; j < N; ++j)
+            {
+                auto best = V::magnitude(e(j, j));
+                auto p = V::set1(T(j));
+                for (int i = j + 1; i < N; ++i)
+                {
+                    const auto x = V::magnitude(e(i, j));
+                    const auto larger = V::greater(x, best);
+                    best = V::select(larger, x, best);
+                    p = V::select(larger, V::set1(T(i)), p);
+                }
+                V::store(pivot[j] + l, p);
+                for (int i = j + 1; i < N; ++i)
+                {
+                    const auto swap = V::equal(p, V::set1(T(i)));
+                    for (int k = 0; k < N; ++k)
+                    {
+                        const auto x = e(j, k), y = e(i, k);
+                        V::store(a[j][k] + l, V::select(swap, y, x));
+                        V::store(a[i][k] + l, V::select(swap, x, y));
+                    }
+                }
+                s = V::select(V::equal(p, V::set1(T(j))), s, V::sub(zero, s));
+
+                const auto d = e(j, j);
+                const auto is_zero = V::equal(d, zero);
+                s = V::select(is_zero, zero, s);
+                const auto r = V::div(one, V::select(is_zero, one, d));
+                V::store(reciprocal[j] + l, r);
+                for (int i = j + 1; i < N; ++i)
+                {
+                    const auto f = V::mul(e(i, j), r);
+                    V::store(a[i][j] + l, f);
+                    for (int k = j + 1; k < N; ++k)
+                        V::store(a[i][k] + l, V::mul_sub(f, e(j, k), e(i, k)));
+                }
+            }
+            V::store(sign + l, s);
+        }
+        for (int l = 0; l < Lanes; ++l)
+            singular[l] = sign[l] == T(0);
+    }
+
+    template<int M>
+    mat_batch<T, N, M, Lanes> solve(mat_batch<T, N, M, Lanes> const& b) const
+    {
+        auto const& a = lu.data;
+        mat_batch<T, N, M, Lanes> x = b;
+        auto& y = x.data;
+        const auto zero = V::set1(T(0));
+        for (int l = 0; l < Lanes; l += V::width)
+        {
+            auto e = [&](int i, int j) { return V::load(a[i][j] + l); };
+
+            // the row swaps of the factorization, then l y = p b and u x = y
+            for (int j = 0; j < N; ++j)
+            {
+                const auto p = V::load(pivot[j] + l);
+                for (int i = j + 1; i < N; ++i)
+                {
+                    const auto swap = V::equal(p, V::set1(T(i)));
+                    for (int c = 0; c < M; ++c)
+                    {
+                        const auto u = V::load(y[j][c] + l), w = V::load(y[i][c] + l);
+                        V::store(y[j][c] + l, V::select(swap, w, u));
+                        V::store(y[i][c] + l, V::select(swap, u, w));
+                    }
+                }
+            }
+            for (int c = 0; c < M; ++c)
+            {
+                for (int i = 1; i < N; ++i)
+                {
+                    auto s = V::load(y[i][c] + l);
+                    for (int k = 0; k < i; ++k)
+                        s = V::mul_sub(e(i, k), V::load(y[k][c] + l), s);
+                    V::store(y[i][c] + l, s);
+                }
+                for (int i = N - 1; i >= 0; --i)
+                {
+                    auto s = V::load(y[i][c] + l);
+                    for (int k = i + 1; k < N; ++k)
+                        s = V::mul_sub(e(i, k), V::load(y[k][c] + l), s);
+                    V::store(y[i][c] + l, V::mul(s, V::load(reciprocal[i] + l)));
+                }
+            }
+
+            const auto is_singular = V::equal(V::load(sign + l), zero);
+            for (int i = 0; i < N; ++i)
+                for (int c = 0; c < M; ++c)
+                    V::store(y[i][c] + l, V::select(is_singular, zero, V::load(y[i][c] + l)));
+        }
+        return x;
+    }
+
+    lanes_t determinant() const
+    {
+        lanes_t det;
+        for (int l = 0; l < Lanes; l += V::width)
+        {
+            auto d = V::load(sign + l);
+            for (int i = 0; i < N; ++i)
+                d = V::mul(d, V::load(lu.data[i][i] + l));
+            V::store(det.data() + l, d);
+        }
+        return det;
+    }
+
+    mat_batch<T, N, N, Lanes> inverse() const
+    {
+        return solve(mat_batch<T, N, N, Lanes>::identity());
+    }
+};
+
+}
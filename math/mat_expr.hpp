@@ -0,0 +1,337 @@
+#pragma once
+
+#include <vec.hpp>
+
+namespace er
+{
+
+// opt in lazy expressions over mat
+//
+// lazy(m) wraps a matrix, and operators with a wrapped operand build an expression instead of a mat.
+// nothing is computed until the expression is assigned, converted to a mat or reduced, and then one row at a time
+// with no intermediate matrices, e.g. squared_norm(lazy(a) * b - lazy_identity<T, N>())
+//
+// a node gives single elements with at(i, j) and whole rows with row(i, out), evaluation goes by rows
+// so a product is a sum of scaled rows that vectorizes like the eager loops.
+// leaves refer to their matrices, so an expression must not outlive them.
+// a product recomputes the rows of its right operand for every row it makes, so a nested product
+// or one that is read more than once is better evaluated first
+
+template<class E>
+concept mat_expression = requires { typename E::lazy_tag; };
+
+template<class Derived, class T, int R, int C>
+struct mat_expr
+{
+    using lazy_tag = void;
+    using value_type = T;
+    ER_STATIC_CONSTEXPR int rows = R;
+    ER_STATIC_CONSTEXPR int cols = C;
+
+    T operator()(int i, int j) const { return static_cast<Derived const&>(*this).at(i, j); }
+    void row(int i, T* out) const { static_cast<Derived const&>(*this).row(i, out); }
+
+    operator mat<T, R, C>() const { return eval(*this); }
+
+    friend mat<T, R, C> eval(mat_expr const& e)
+    {
+        mat<T, R, C> result;
+        for (int i = 0; i < R; ++i)
+            e.row(i, result.raw_data[i]);
+        return result;
+    }
+};
+
+template<class T, int R, int C>
+struct mat_leaf : mat_expr<mat_leaf<T, R, C>, T, R, C>
+{
+    ER_STATIC_CONSTEXPR bool element_wise = true;
+    mat<T, R, C> const* m;
+
+    explicit mat_leaf(mat<T, R, C> const& m) : m(&m) {}
+    T at(int i, int j) const { return m->raw_data[i][j]; }
+    void row(int i, T* out) const { std::copy_n(m->raw_data[i], C, out); }
+    // rows that are already in memory are read in place
+    T const* row_data(int i) const { return m->raw_data[i]; }
+};
+
+template<class T, int N>
+struct mat_identity : mat_expr<mat_identity<T, N>, T, N, N>
+{
+    ER_STATIC_CONSTEXPR bool element_wise = true;
+    T at(int i, int j) const { return i == j ? T(1) : T(0); }
+    void row(int i, T* out) const
+    {
+        std::fill_n(out, N, T(0));
+        out[i] = T(1);
+    }
+};
+
+template<auto F, class E>
+struct mat_unary : mat_expr<mat_unary<F, E>, typename E::value_type, E::rows, E::cols>
+{
+    ER_STATIC_CONSTEXPR bool element_wise = E::element_wise;
+    E e;
+
+    explicit mat_unary(E const& e) : e(e) {}
+    auto at(int i, int j) const { return F(e(i, j)); }
+    void row(int i, typename E::value_type* out) const
+    {
+        e.row(i, out);
+        for (int j = 0; j < E::cols; ++j)
+            out[j] = F(out[j]);
+    }
+};
+
+template<auto F, class X, class Y>
+struct mat_binary : mat_expr<mat_binary<F, X, Y>, typename X::value_type, X::rows, X::cols>
+{
+    static_assert(X::rows == Y::rows && X::cols == Y::cols, "element wise operands differ in shape");
+    ER_STATIC_CONSTEXPR bool element_wise = X::element_wise && Y::element_wise;
+    X x;
+    Y y;
+
+    mat_binary(X const& x, Y const& y) : x(x), y(y) {}
+    auto at(int i, int j) const { return F(x(i, j), y(i, j)); }
+    void row(int i, typename X::value_type* out) const
+    {
+        typename Y::value_type other[X::cols];
+        x.row(i, out);
+        y.row(i, other);
+        for (int j = 0; j < X::cols; ++j)
+            out[j] = F(out[j], other[j]);
+    }
+};
+
+// F(e, s) with a scalar s, or F(s, e) when Left
+template<auto F, class E, bool Left = false>
+struct mat_scalar : mat_expr<mat_scalar<F, E, Left>, typename E::value_type, E::rows, E::cols>
+{
+    using T = typename E::value_type;
+    ER_STATIC_CONSTEXPR bool element_wise = E::element_wise;
+    E e;
+    T s;
+
+    mat_scalar(E const& e, T const& s) : e(e), s(s) {}
+    T at(int i, int j) const { return Left ? F(s, e(i, j)) : F(e(i, j), s); }
+    void row(int i, T* out) const
+    {
+        e.row(i, out);
+        for (int j = 0; j < E::cols; ++j)
+            out[j] = Left ? F(s, out[j]) : F(out[j], s);
+    }
+};
+
+template<class X, class Y>
+struct mat_product : mat_expr<mat_product<X, Y>, typename X::value_type, X::rows, Y::cols>
+{
+    static_assert(X::cols == Y::rows, "product of mismatched shapes");
+    using T = typename X::value_type;
+    ER_STATIC_CONSTEXPR bool element_wise = false;
+    X x;
+    Y y;
+
+    mat_product(X const& x, Y const& y) : x(x), y(y) {}
+    T at(int i, int j) const
+    {
+        T s = x(i, 0) * y(0, j);
+        for (int k = 1; k < X::cols; ++k)
+            s += x(i, k) * y(k, j);
+        return s;
+    }
+    // row i of x times y, as the sum of the rows of y scaled by row i of x
+    void row(int i, T* out) const
+    {
+        T a[X::cols], b[Y::cols];
+        x.row(i, a);
+        std::fill_n(out, Y::cols, T(0));
+        ER_UNROLL
+        for (int k = 0; k < X::cols; ++k)
+        {
+            T const* yk = b;
+            if constexpr (requires { y.row_data(k); })
+                yk = y.row_data(k);
+            else
+                y.row(k, b);
+            for (int j = 0; j < Y::cols; ++j)
+                out[j] += a[k] * yk[j];
+        }
+    }
+};
+
+template<class E>
+struct mat_transposed : mat_expr<mat_transposed<E>, typename E::value_type, E::cols, E::rows>
+{
+    // row i reads column i
+    ER_STATIC_CONSTEXPR bool element_wise = false;
+    E e;
+
+    explicit mat_transposed(E const& e) : e(e) {}
+    auto at(int i, int j) const { return e(j, i); }
+    void row(int i, typename E::value_type* out) const
+    {
+        for (int j = 0; j < E::rows; ++j)
+            out[j] = e(j, i);
+    }
+};
+
+template<class T, int R, int C>
+mat_leaf<T, R, C> lazy(mat<T, R, C> const& m) { return mat_leaf<T, R, C>(m); }
+
+template<class T, int N>
+mat_identity<T, N> lazy_identity() { return {}; }
+
+namespace detail
+{
+
+template<class X>
+auto as_expression(X const& x)
+{
+    if constexpr (mat_expression<X>)
+        return x;
+    else
+        return lazy(x);
+}
+
+template<class X>
+struct is_mat : std::false_type {};
+
+template<class T, int R, int C>
+struct is_mat<mat<T, R, C>> : std::true_type {};
+
+// an expression with an expression or a mat, so mat with mat keeps its eager operators
+template<class X, class Y>
+concept lazy_operands = (mat_expression<X> && (mat_expression<Y> || is_mat<Y>::value)) || (is_mat<X>::value && mat_expression<Y>);
+
+template<class X>
+using lazy_t = decltype(as_expression(std::declval<X>()));
+
+}
+
+template<class X, class Y> requires detail::lazy_operands<X, Y>
+auto operator+(X const& x, Y const& y)
+{
+    using T = typename detail::lazy_t<X>::value_type;
+    return mat_binary<add<T>, detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<class X, class Y> requires detail::lazy_operands<X, Y>
+auto operator-(X const& x, Y const& y)
+{
+    using T = typename detail::lazy_t<X>::value_type;
+    return mat_binary<sub<T>, detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<class X, class Y> requires detail::lazy_operands<X, Y>
+auto operator*(X const& x, Y const& y)
+{
+    return mat_product<detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<class X, class Y> requires detail::lazy_operands<X, Y>
+auto comp_mul(X const& x, Y const& y)
+{
+    using T = typename detail::lazy_t<X>::value_type;
+    return mat_binary<mul<T>, detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<class X, class Y> requires detail::lazy_operands<X, Y>
+auto comp_div(X const& x, Y const& y)
+{
+    using T = typename detail::lazy_t<X>::value_type;
+    return mat_binary<div<T>, detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<auto F, class X, class Y> requires detail::lazy_operands<X, Y>
+auto element_wise(X const& x, Y const& y)
+{
+    return mat_binary<F, detail::lazy_t<X>, detail::lazy_t<Y>>(detail::as_expression(x), detail::as_expression(y));
+}
+
+template<mat_expression E>
+auto operator*(E const& e, typename E::value_type const& s) { return mat_scalar<mul<typename E::value_type>, E>(e, s); }
+
+template<mat_expression E>
+auto operator*(typename E::value_type const& s, E const& e) { return mat_scalar<mul<typename E::value_type>, E, true>(e, s); }
+
+template<mat_expression E>
+auto operator/(E const& e, typename E::value_type const& s) { return mat_scalar<div<typename E::value_type>, E>(e, s); }
+
+template<mat_expression E>
+auto operator-(E const& e) { return mat_unary<neg<typename E::value_type>, E>(e); }
+
+template<auto F, mat_expression E>
+auto transform(E const& e) { return mat_unary<F, E>(e); }
+
+template<mat_expression E>
+auto transpose(E const& e) { return mat_transposed<E>(e); }
+
+// f(s, x) over the elements of e a row at a time, with one accumulator per column so the rows vectorize,
+// the columns are combined with g at the end
+template<mat_expression E, class F, class G>
+auto fold_rows(E const& e, typename E::value_type init, F&& f, G&& g)
+{
+    using T = typename E::value_type;
+    T r[E::cols], s[E::cols];
+    std::fill_n(s, E::cols, init);
+    for (int i = 0; i < E::rows; ++i)
+    {
+        e.row(i, r);
+        for (int j = 0; j < E::cols; ++j)
+            s[j] = f(s[j], r[j]);
+    }
+    T result = s[0];
+    for (int j = 1; j < E::cols; ++j)
+        result = g(result, s[j]);
+    return result;
+}
+
+template<mat_expression E>
+auto fold_add(E const& e)
+{
+    using T = typename E::value_type;
+    return fold_rows(e, T(0), add<T>, add<T>);
+}
+
+template<mat_expression E>
+auto fold_mul(E const& e)
+{
+    using T = typename E::value_type;
+    return fold_rows(e, T(1), mul<T>, mul<T>);
+}
+
+// the squared frobenius norm
+template<mat_expression E>
+auto squared_norm(E const& e)
+{
+    using T = typename E::value_type;
+    return fold_rows(e, T(0), [](T s, T x) { return s + x * x; }, add<T>);
+}
+
+// m = e, a row at a time when every row of e only reads the same row of its operands,
+// else through one temporary since e may read m
+template<class T, int R, int C, mat_expression E>
+mat<T, R, C>& assign(mat<T, R, C>& m, E const& e)
+{
+    static_assert(E::rows == R && E::cols == C, "assigning an expression of another shape");
+    if constexpr (E::element_wise)
+    {
+        T r[C];
+        for (int i = 0; i < R; ++i)
+        {
+            e.row(i, r);
+            std::copy_n(r, C, m.raw_data[i]);
+        }
+        return m;
+    }
+    else
+        return m = eval(e);
+}
+
+template<class T, int R, int C, mat_expression E>
+mat<T, R, C>& operator+=(mat<T, R, C>& m, E const& e) { return assign(m, lazy(m) + e); }
+
+template<class T, int R, int C, mat_expression E>
+mat<T, R, C>& operator-=(mat<T, R, C>& m, E const& e) { return assign(m, lazy(m) - e); }
+
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <defines.hpp>
+#include <type_traits>
+
+#if !defined(ER_MAT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define ER_MAT_SSE
+#include <immintrin.h>
+#if defined(__AVX__)
+#define ER_MAT_AVX
+#endif
+#endif
+
+namespace er
+{
+
+namespace detail
+{
+
+// sse and avx kernels for the small float matrices, picked by specializing on the element type and shape
+// operands are the row major raw data of a mat, so none of this depends on mat itself
+// a specialization only declares what it speeds up and mat keeps its loops for everything else
+// define ER_MAT_NO_SIMD to always take the loops
+template<class T, int R, int C>
+struct mat_kernel
+{
+};
+
+// the alignment of mat<T, R, C>, fixed per type whatever the instruction set or ER_MAT_NO_SIMD
+// so translation units built with and without avx agree on the layout, the kernels load rows aligned to it
+template<class T, int R, int C>
+struct mat_alignment : std::integral_constant<size_t, alignof(T)> {};
+
+template<> struct mat_alignment<f32, 4, 4> : std::integral_constant<size_t, 16> {};
+template<> struct mat_alignment<f32, 1, 4> : std::integral_constant<size_t, 16> {};
+template<> struct mat_alignment<f64, 4, 4> : std::integral_constant<size_t, 32> {};
+template<> struct mat_alignment<f64, 1, 4> : std::integral_constant<size_t, 32> {};
+
+// the element wise functions that map to a single lane instruction
+enum class lane_op { none, add, sub, mul, div };
+
+template<class T, auto F>
+constexpr lane_op lane_op_of()
+{
+    if constexpr (std::is_same_v<decltype(F), decltype(&add<T>)>)
+    {
+        if (F == &add<T>) return lane_op::add;
+        if (F == &sub<T>) return lane_op::sub;
+        if (F == &mul<T>) return lane_op::mul;
+        if (F == &div<T>) return lane_op::div;
+    }
+    return lane_op::none;
+}
+
+template<class V, lane_op Op, class X>
+X lanes_apply(X x, X y)
+{
+    if constexpr (lane_op::add == Op) return V::add(x, y);
+    else if constexpr (lane_op::sub == Op) return V::sub(x, y);
+    else if constexpr (lane_op::mul == Op) return V::mul(x, y);
+    else return V::div(x, y);
+}
+
+template<class T, lane_op Op>
+T scalar_apply(T x, T y)
+{
+    if constexpr (lane_op::add == Op) return x + y;
+    else if constexpr (lane_op::sub == Op) return x - y;
+    else if constexpr (lane_op::mul == Op) return x * y;
+    else return x / y;
+}
+
+// an operand is either N values or one value broadcast to all of them
+template<class V> typename V::reg lanes_of(typename V::type const* p, int i) { return V::load(p + i); }
+template<class V> typename V::reg lanes_of(typename V::type x, int) { return V::set1(x); }
+template<class T> T value_of(T const* p, int i) { return p[i]; }
+template<class T> T value_of(T x, int) { return x; }
+
+// r[0..N) = x Op y, full registers first and the rest one value at a time
+template<class V, lane_op Op, int N, class X, class Y>
+void lanes_element_wise(typename V::type* r, X x, Y y)
+{
+    int i = 0;
+    for (; i + V::width <= N; i += V::width)
+        V::store(r + i, lanes_apply<V, Op>(lanes_of<V>(x, i), lanes_of<V>(y, i)));
+    for (; i < N; ++i)
+        r[i] = scalar_apply<typename V::type, Op>(value_of(x, i), value_of(y, i));
+}
+
+#if defined(ER_MAT_SSE)
+
+struct sse_f32
+{
+    using type = f32;
+    using reg = __m128;
+    ER_STATIC_CONSTEXPR int width = 4;
+
+    static reg load(f32 const* p) { return _mm_loadu_ps(p); }
+    static void store(f32* p, reg v) { _mm_storeu_ps(p, v); }
+    static reg set1(f32 x) { return _mm_set1_ps(x); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+};
+
+#if defined(ER_MAT_AVX)
+struct avx_f64
+{
+    using type = f64;
+    using reg = __m256d;
+    ER_STATIC_CONSTEXPR int width = 4;
+
+    static reg load(f64 const* p) { return _mm256_loadu_pd(p); }
+    static void store(f64* p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(f64 x) { return _mm256_set1_pd(x); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+};
+#endif
+
+// rows of three floats as (x, y, z, 0), never touching memory past the row
+inline __m128 load3(f32 const* p)
+{
+    return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (__m64 const*)p), _mm_load_ss(p + 2));
+}
+
+inline void store3(f32* p, __m128 v)
+{
+    _mm_storel_pi((__m64*)p, v);
+    _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+
+inline __m128 cross3(__m128 a, __m128 b)
+{
+    const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+inline f32 horizontal_sum(__m128 v)
+{
+    const __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+
+// r = x * y for Rows rows of four and a 4x4 y, every row of r is a sum of rows of y
+template<int Rows>
+void mul_rows4(f32* r, f32 const* x, f32 const* y)
+{
+    const __m128 y0 = _mm_load_ps(y), y1 = _mm_load_ps(y + 4), y2 = _mm_load_ps(y + 8), y3 = _mm_load_ps(y + 12);
+    for (int i = 0; i < Rows; ++i)
+    {
+        f32 const* xi = x + 4 * i;
+        __m128 s = _mm_mul_ps(_mm_set1_ps(xi[0]), y0);
+        s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(xi[1]), y1));
+        s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(xi[2]), y2));
+        s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(xi[3]), y3));
+        _mm_store_ps(r + 4 * i, s);
+    }
+}
+
+template<>
+struct mat_kernel<f32, 4, 4>
+{
+    using lanes = sse_f32;
+
+    static void mul(f32* r, f32 const* x, f32 const* y) { mul_rows4<4>(r, x, y); }
+
+    static void transpose(f32* r, f32 const* m)
+    {
+        __m128 r0 = _mm_load_ps(m), r1 = _mm_load_ps(m + 4), r2 = _mm_load_ps(m + 8), r3 = _mm_load_ps(m + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_store_ps(r, r0);
+        _mm_store_ps(r + 4, r1);
+        _mm_store_ps(r + 8, r2);
+        _mm_store_ps(r + 12, r3);
+    }
+
+    // rows of the adjugate from the 2x2 minors of rows 0, 1 and rows 2, 3, returns the determinant
+    static f32 adjugate(__m128 (&b)[4], f32 const* m)
+    {
+        const __m128 r0 = _mm_load_ps(m), r1 = _mm_load_ps(m + 4), r2 = _mm_load_ps(m + 8), r3 = _mm_load_ps(m + 12);
+
+        // e[j] = (a2j, a2j, a0j, a0j), f[j] = (a3j, a3j, a1j, a1j)
+        const __m128 lo20 = _mm_unpacklo_ps(r2, r0), hi20 = _mm_unpackhi_ps(r2, r0);
+        const __m128 lo31 = _mm_unpacklo_ps(r3, r1), hi31 = _mm_unpackhi_ps(r3, r1);
+        const __m128 e[4] = {
+            _mm_shuffle_ps(lo20, lo20, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(lo20, lo20, _MM_SHUFFLE(3, 3, 2, 2)),
+            _mm_shuffle_ps(hi20, hi20, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(hi20, hi20, _MM_SHUFFLE(3, 3, 2, 2)),
+        };
+        const __m128 f[4] = {
+            _mm_shuffle_ps(lo31, lo31, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(lo31, lo31, _MM_SHUFFLE(3, 3, 2, 2)),
+            _mm_shuffle_ps(hi31, hi31, _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(hi31, hi31, _MM_SHUFFLE(3, 3, 2, 2)),
+        };
+
+        // the minors of columns p < q as (c, c, s, s), c from rows 2, 3 and s from rows 0, 1
+        auto minor = [&](int p, int q) { return _mm_sub_ps(_mm_mul_ps(e[p], f[q]), _mm_mul_ps(f[p], e[q])); };
+        const __m128 p01 = minor(0, 1), p02 = minor(0, 2), p03 = minor(0, 3);
+        const __m128 p12 = minor(1, 2), p13 = minor(1, 3), p23 = minor(2, 3);
+
+        // v[j] = (a1j, -a0j, a3j, -a2j)
+        const __m128 sign = _mm_setr_ps(0.f, -0.f, 0.f, -0.f);
+        const __m128 lo10 = _mm_unpacklo_ps(r1, r0), hi10 = _mm_unpackhi_ps(r1, r0);
+        const __m128 lo32 = _mm_unpacklo_ps(r3, r2), hi32 = _mm_unpackhi_ps(r3, r2);
+        const __m128 v0 = _mm_xor_ps(_mm_movelh_ps(lo10, lo32), sign), v1 = _mm_xor_ps(_mm_movehl_ps(lo32, lo10), sign);
+        const __m128 v2 = _mm_xor_ps(_mm_movelh_ps(hi10, hi32), sign), v3 = _mm_xor_ps(_mm_movehl_ps(hi32, hi10), sign);
+
+        b[0] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v1, p23), _mm_mul_ps(v2, p13)), _mm_mul_ps(v3, p12));
+        b[1] = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(v2, p03), _mm_mul_ps(v0, p23)), _mm_mul_ps(v3, p02));
+        b[2] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v0, p13), _mm_mul_ps(v1, p03)), _mm_mul_ps(v3, p01));
+        b[3] = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(v1, p02), _mm_mul_ps(v0, p12)), _mm_mul_ps(v2, p01));
+
+        // first row of m against the first column of the adjugate
+        const __m128 col0 = _mm_movelh_ps(_mm_unpacklo_ps(b[0], b[1]), _mm_unpacklo_ps(b[2], b[3]));
+        return horizontal_sum(_mm_mul_ps(r0, col0));
+    }
+
+    static f32 determinant(f32 const* m)
+    {
+        __m128 b[4];
+        return adjugate(b, m);
+    }
+
+    // false for a singular m, r is left untouched then
+    static bool inverse(f32* r, f32 const* m)
+    {
+        __m128 b[4];
+        const f32 det = adjugate(b, m);
+        if (det == 0.f)
+            return false;
+        const __m128 d = _mm_set1_ps(det);
+        for (int i = 0; i < 4; ++i)
+            _mm_store_ps(r + 4 * i, _mm_div_ps(b[i], d));
+        return true;
+    }
+};
+
+template<>
+struct mat_kernel<f32, 1, 4>
+{
+    using lanes = sse_f32;
+
+    static void mul(f32* r, f32 const* x, f32 const* y) { mul_rows4<1>(r, x, y); }
+};
+
+// rows are 12 bytes apart, so nothing here relies on alignment
+template<>
+struct mat_kernel<f32, 3, 3>
+{
+    using lanes = sse_f32;
+
+    static void mul(f32* r, f32 const* x, f32 const* y)
+    {
+        const __m128 y0 = load3(y), y1 = load3(y + 3), y2 = load3(y + 6);
+        for (int i = 0; i < 3; ++i)
+        {
+            f32 const* xi = x + 3 * i;
+            __m128 s = _mm_mul_ps(_mm_set1_ps(xi[0]), y0);
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(xi[1]), y1));
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(xi[2]), y2));
+            store3(r + 3 * i, s);
+        }
+    }
+
+    static void transpose(f32* r, f32 const* m)
+    {
+        __m128 r0 = load3(m), r1 = load3(m + 3), r2 = load3(m + 6), r3 = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        store3(r, r0);
+        store3(r + 3, r1);
+        store3(r + 6, r2);
+    }
+
+    static f32 determinant(f32 const* m)
+    {
+        return horizontal_sum(_mm_mul_ps(load3(m), cross3(load3(m + 3), load3(m + 6))));
+    }
+
+    // the rows of the cofactor matrix are cross products of the other two rows
+    static bool inverse(f32* r, f32 const* m)
+    {
+        const __m128 r0 = load3(m), r1 = load3(m + 3), r2 = load3(m + 6);
+        __m128 c0 = cross3(r1, r2), c1 = cross3(r2, r0), c2 = cross3(r0, r1), c3 = _mm_setzero_ps();
+        const f32 det = horizontal_sum(_mm_mul_ps(r0, c0));
+        if (det == 0.f)
+            return false;
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        const __m128 d = _mm_set1_ps(det);
+        store3(r, _mm_div_ps(c0, d));
+        store3(r + 3, _mm_div_ps(c1, d));
+        store3(r + 6, _mm_div_ps(c2, d));
+        return true;
+    }
+};
+
+#if defined(ER_MAT_AVX)
+template<>
+struct mat_kernel<f64, 4, 4>
+{
+    using lanes = avx_f64;
+
+    static void mul(f64* r, f64 const* x, f64 const* y)
+    {
+        const __m256d y0 = _mm256_load_pd(y), y1 = _mm256_load_pd(y + 4), y2 = _mm256_load_pd(y + 8), y3 = _mm256_load_pd(y + 12);
+        for (int i = 0; i < 4; ++i)
+        {
+            f64 const* xi = x + 4 * i;
+            __m256d s = _mm256_mul_pd(_mm256_set1_pd(xi[0]), y0);
+            s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_set1_pd(xi[1]), y1));
+            s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_set1_pd(xi[2]), y2));
+            s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_set1_pd(xi[3]), y3));
+            _mm256_store_pd(r + 4 * i, s);
+        }
+    }
+
+    static void transpose(f64* r, f64 const* m)
+    {
+        const __m256d r0 = _mm256_load_pd(m), r1 = _mm256_load_pd(m + 4), r2 = _mm256_load_pd(m + 8), r3 = _mm256_load_pd(m + 12);
+        const __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1);
+        const __m256d t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+        _mm256_store_pd(r, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_store_pd(r + 4, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_store_pd(r + 8, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_store_pd(r + 12, _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+};
+
+template<>
+struct mat_kernel<f64, 1, 4>
+{
+    using lanes = avx_f64;
+};
+#endif
+
+#endif
+
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <num.hpp>
+
+namespace er
+{
+
+// arithmetic modulo an odd m on residues kept in montgomery form a * R mod m, R = B^n
+// residues are caller owned buffers of size() digits, outputs may alias inputs
+// the context owns its scratch space, so one context must not be shared between threads
+struct montgomery
+{
+    num modulus;
+    size_t n = 0;
+    digit m_inv = 0;       // -m^-1 mod B
+    num::digits r2;        // R^2 mod m, not in montgomery form
+    num::digits r3;        // R^3 mod m, not in montgomery form
+    num::digits t;         // scratch for products
+    num::digits g;         // scratch for inverse
+    num::digits tmp;       // scratch below products, sized for the thresholds at construction
+    std::vector<digit> table;
+
+    explicit montgomery(num const& m) : modulus(m)
+    {
+        assert(!m.extension && m.get(0) & 1 && m > 1);
+        n = m.data.size();
+
+        // newton iteration for the inverse of the low digit, each step doubles the correct bits
+        const digit m0 = m.data[0];
+        digit inv = m0;
+        for (int i = 0; i < 6; ++i)
+            inv *= 2 - m0 * inv;
+        m_inv = (digit(0) - inv) & num::mask;
+
+        r2 = reduced(num::shift_digits(1, 2 * n));
+        t.resize(2 * n + 1);
+        tmp.resize(num::mul_scratch(n, n));
+        r3.resize(n);
+        mul(r3.data(), r2.data(), r2.data());
+        g.resize(4 * n + 2);
+    }
+
+    size_t size() const { return n; }
+
+    // r = t * R^-1 mod m for t = this->t holding a value below m * R
+    void redc(digit* r)
+    {
+        // zero the low digits one at a time by adding multiples of m
+        digit top = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const digit q = (t[i] * m_inv) & num::mask;
+            const digit carry = num::addmul_1(t.data() + i, modulus.data.data(), n, q);
+            t[i + n] = num::adc(t[i + n], carry, top);
+        }
+        t[2 * n] = top;
+
+        digit* hi = t.data() + n;
+        if (hi[n] || num::cmp(hi, n, modulus.data.data(), n) >= 0)
+            num::sub(hi, hi, n + 1, modulus.data.data(), n);
+        std::copy(hi, hi + n, r);
+    }
+
+    void mul(digit* r, digit const* a, digit const* b)
+    {
+        assert(tmp.size() >= num::mul_scratch(n, n));
+        num::mul(t.data(), a, n, b, n, tmp.data());
+        redc(r);
+    }
+
+    void sqr(digit* r, digit const* a)
+    {
+        assert(tmp.size() >= num::mul_scratch(n, n));
+        num::sqr(t.data(), a, n, tmp.data());
+        redc(r);
+    }
+
+    // r = a^e, fixed window exponentiation
+    void pow(digit* r, digit const* a, num const& e)
+    {
+        assert(!e.extension);
+        const int e_bits = num::num_bits(e);
+        const int w = e_bits > 512 ? 6 : e_bits > 128 ? 5 : e_bits > 32 ? 4 : e_bits > 8 ? 3 : 1;
+
+        // table[i] = a^i
+        table.resize(n << w);
+        one(table.data());
+        std::copy(a, a + n, table.data() + n);
+        for (size_t i = 2; i < (size_t(1) << w); ++i)
+            mul(table.data() + i * n, table.data() + (i - 1) * n, a);
+
+        if (!e_bits)
+            return one(r);
+        int pos = ((e_bits - 1) / w) * w;
+        const digit top = num::extract_bits(e, pos, w);
+        std::copy(table.data() + top * n, table.data() + (top + 1) * n, r);
+        for (pos -= w; pos >= 0; pos -= w)
+        {
+            for (int i = 0; i < w; ++i)
+                sqr(r, r);
+            const digit idx = num::extract_bits(e, pos, w);
+            if (idx)
+                mul(r, r, table.data() + idx * n);
+        }
+    }
+
+    // r = a^-1, returns false if a is not invertible
+    // binary extended gcd on the context's scratch, keeping x1 a = u and x2 a = v mod m while u and v shrink to 0 and gcd(a, m),
+    // that gives the plain inverse of the montgomery form a R, one product with R^3 puts it back as a^-1 R
+    bool inverse(digit* r, digit const* a)
+    {
+        digit* u = g.data();
+        digit* v = u + n;
+        digit* x1 = v + n;
+        digit* x2 = x1 + n + 1;
+        digit const* m = modulus.data.data();
+        std::copy(a, a + n, u);
+        std::copy(m, m + n, v);
+        std::fill(x1, x1 + 2 * n + 2, digit(0));
+        x1[0] = 1;
+
+        auto is_zero = [&](digit const* x) { return std::all_of(x, x + n, [](digit d) { return 0 == d; }); };
+        // x = x 2^-k mod m: adding q m with q = -x m^-1 mod 2^k clears the low k bits, and (x + q m) / 2^k stays below m
+        auto halve = [&](digit* x, int k)
+        {
+            const digit q = (x[0] * m_inv) & ((digit(1) << k) - 1);
+            x[n] = num::addmul_1(x, m, n, q);
+            num::rshift(x, x, n + 1, k);
+        };
+        // x = x - y mod m
+        auto sub_mod = [&](digit* x, digit const* y)
+        {
+            if (num::sub(x, x, n, y, n))
+                num::add(x, x, n, m, n);
+        };
+
+        if (is_zero(u))
+            return false;
+        while (!is_zero(u))
+        {
+            // v stays odd, only u picks up factors of two
+            while (!(u[0] & 1))
+            {
+                const int k = u[0] ? std::min<int>(std::countr_zero(u[0]), int(num::bits) - 1) : int(num::bits) - 1;
+                num::rshift(u, u, n, k);
+                halve(x1, k);
+            }
+            if (num::cmp(u, n, v, n) >= 0)
+            {
+                num::sub(u, u, n, v, n);
+                sub_mod(x1, x2);
+            }
+            else
+            {
+                num::sub(v, v, n, u, n);
+                sub_mod(x2, x1);
+                std::swap(u, v);
+                std::swap(x1, x2);
+            }
+        }
+        if (v[0] != 1 || !std::all_of(v + 1, v + n, [](digit d) { return 0 == d; }))
+            return false;
+        mul(r, x2, r3.data());
+        return true;
+    }
+
+    // r = 1 in montgomery form
+    void one(digit* r)
+    {
+        std::fill(t.begin(), t.end(), digit(0));
+        std::copy(r2.begin(), r2.end(), t.begin());
+        redc(r);
+    }
+
+    void to_montgomery(digit* r, num const& a)
+    {
+        const num::digits v = reduced(a);
+        mul(r, v.data(), r2.data());
+    }
+
+    num from_montgomery(digit const* a)
+    {
+        std::fill(t.begin(), t.end(), digit(0));
+        std::copy(a, a + n, t.begin());
+        num::digits res(n);
+        redc(res.data());
+        return num::from_digits(res.data(), n);
+    }
+
+    // a^e mod m
+    num pow(num const& a, num const& e)
+    {
+        num::digits x(n);
+        to_montgomery(x.data(), a);
+        pow(x.data(), x.data(), e);
+        return from_montgomery(x.data());
+    }
+
+private:
+    // a mod m as exactly n digits
+    num::digits reduced(num const& a) const
+    {
+        num v = a % modulus;
+        if (v.extension)
+            v += modulus;
+        num::digits res(n);
+        std::copy(v.data.begin(), v.data.end(), res.begin());
+        return res;
+    }
+};
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <dyn_mat.hpp>
+
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace er
+{
+
+// how a newton schulz inverse went, the residuals are |I - m x| in the frobenius norm
+// stalled is set when a step stopped reducing the residual, which rounding does once it is near epsilon
+struct newton_schulz_stats
+{
+    size_t iterations = 0;
+    bool converged = false;
+    bool stalled = false;
+    double initial_residual = 0;
+    double residual = 0;
+};
+
+template<class M>
+struct newton_schulz_result
+{
+    M inverse;
+    newton_schulz_stats stats;
+};
+
+namespace detail
+{
+
+// x0 = m^T / (|m|_1 |m|_inf) puts every eigenvalue of x0 m in (0, 1], so the iteration converges for any non singular m,
+// after Pan and Schreiber, an improved Newton iteration for the generalized inverse of a matrix
+template<class T>
+T newton_schulz_scale(T const* row_sums, T const* col_sums, size_t n)
+{
+    T r = T(0), c = T(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        r = std::max(r, row_sums[i]);
+        c = std::max(c, col_sums[i]);
+    }
+    return r * c == T(0) ? T(0) : T(1) / (r * c);
+}
+
+// within tolerance, or stuck at the rounding floor after the quadratic phase
+template<class T>
+bool newton_schulz_converged(newton_schulz_stats const& stats, T tolerance)
+{
+    return stats.residual <= double(tolerance) || (stats.stalled && stats.residual <= std::sqrt(double(std::numeric_limits<T>::epsilon())));
+}
+
+}
+
+// m^-1 by the newton schulz (hotelling) iteration x += x (I - m x), which squares the residual I - m x every step,
+// two matrix products per step and roughly 2 log2(cond m) + 5 steps from the scaled start, so lu is cheaper
+// for a one off inverse, this is for where products are cheap or lu's pivoting is unwanted
+// stops once the residual is within tolerance, after max_iterations updates, or when a step stops reducing it,
+// so the default tolerance of 0 iterates to working precision, that last step is measured but not kept
+// a zero m gives a zero inverse, a singular one never converges
+template<class T, int N>
+newton_schulz_result<mat<T, N, N>> newton_schulz_inverse(mat<T, N, N> const& m,
+    T tolerance = T(0), size_t max_iterations = 100)
+{
+    newton_schulz_result<mat<T, N, N>> res;
+    auto& stats = res.stats;
+
+    T row_sums[N] = {}, col_sums[N] = {};
+    for (int i = 0; i < N; ++i)
+    {
+        for (int j = 0; j < N; ++j)
+        {
+            row_sums[i] += std::abs(m(i, j));
+            col_sums[j] += std::abs(m(i, j));
+        }
+    }
+    const T scale = detail::newton_schulz_scale(row_sums, col_sums, N);
+    if (scale == T(0))
+    {
+        stats.initial_residual = stats.residual = std::sqrt(double(N));
+        return res;
+    }
+
+    // squared residuals decide, so no square root is on the path from one step to the next
+    const mat<T, N, N> id = mat<T, N, N>::identity();
+    const double tolerance_sq = double(tolerance) * double(tolerance);
+    mat<T, N, N> x = transpose(m) * scale, r;
+    double previous = std::numeric_limits<double>::infinity();
+    for (;;)
+    {
+        r = id - m * x;
+        const double sq = double(fold_add(comp_mul(r, r)));
+        if (0 == stats.iterations)
+            stats.initial_residual = std::sqrt(sq);
+        if (sq >= previous)
+        {
+            stats.stalled = true;
+            break;
+        }
+        res.inverse = x;
+        previous = sq;
+        if (sq <= tolerance_sq || stats.iterations == max_iterations)
+            break;
+        x += x * r;
+        ++stats.iterations;
+    }
+    stats.residual = std::sqrt(previous);
+    stats.converged = detail::newton_schulz_converged(stats, tolerance);
+    return res;
+}
+
+// the same for run time sizes, the products go through gemm into buffers that, with gemm's packing space,
+// are allocated before the first step and reused by every step after it
+template<class T>
+newton_schulz_result<dyn_mat<T>> newton_schulz_inverse(dyn_mat<T> const& m,
+    T tolerance = T(0), size_t max_iterations = 100)
+{
+    assert(m.rows == m.cols);
+    const size_t n = m.rows;
+    newton_schulz_result<dyn_mat<T>> res;
+    auto& stats = res.stats;
+
+    std::vector<T> row_sums(n), col_sums(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (size_t j = 0; j < n; ++j)
+        {
+            row_sums[i] += std::abs(m(i, j));
+            col_sums[j] += std::abs(m(i, j));
+        }
+    }
+    const T scale = detail::newton_schulz_scale(row_sums.data(), col_sums.data(), n);
+    res.inverse = dyn_mat<T>(n, n);
+    if (scale == T(0))
+    {
+        stats.initial_residual = stats.residual = std::sqrt(double(n));
+        return res;
+    }
+
+    // x is the current iterate and res.inverse the best one so far, next takes x + x r
+    const double tolerance_sq = double(tolerance) * double(tolerance);
+    dyn_mat<T> x = transpose(m), r(n, n), next(n, n);
+    detail::gemm_workspace<T> ws;
+    x *= scale;
+    double previous = std::numeric_limits<double>::infinity();
+    for (;;)
+    {
+        gemm(r, m, x, T(-1), T(0), ws);
+        T sq = T(0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            r(i, i) += T(1);
+            T const* ri = r[i];
+            for (size_t j = 0; j < n; ++j)
+                sq += ri[j] * ri[j];
+        }
+        if (0 == stats.iterations)
+            stats.initial_residual = std::sqrt(double(sq));
+        if (double(sq) >= previous)
+        {
+            stats.stalled = true;
+            break;
+        }
+        std::swap(res.inverse, x);
+        previous = double(sq);
+        if (previous <= tolerance_sq || stats.iterations == max_iterations)
+            break;
+        next.data = res.inverse.data;
+        gemm(next, res.inverse, r, T(1), T(1), ws);
+        std::swap(x, next);
+        ++stats.iterations;
+    }
+    stats.residual = std::sqrt(previous);
+    stats.converged = detail::newton_schulz_converged(stats, tolerance);
+    return res;
+}
+
+}
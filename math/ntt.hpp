@@ -0,0 +1,210 @@
+#pragma once
+
+#include <defines.hpp>
+#include <algorithm>
+#include <bit>
+#include <thread>
+#include <vector>
+
+namespace er
+{
+
+// integer convolution through number theoretic transforms modulo three primes,
+// the exact coefficients are recovered with the chinese remainder theorem
+namespace ntt
+{
+
+// arithmetic modulo the prime P = c * 2^k + 1 with primitive root G
+template<u32 P, u32 G>
+struct field
+{
+    ER_STATIC_CONSTEXPR u32 mod = P;
+    ER_STATIC_CONSTEXPR int two_adicity = std::countr_zero(P - 1);
+
+    static u32 add(u32 a, u32 b) { u32 r = a + b; return r >= P ? r - P : r; }
+    static u32 sub(u32 a, u32 b) { return a >= b ? a - b : a + P - b; }
+    static u32 mul(u32 a, u32 b) { return u32(u64(a) * b % P); }
+
+    static u32 pow(u32 a, u64 e)
+    {
+        u32 r = 1;
+        for (; e; e >>= 1, a = mul(a, a))
+            if (e & 1)
+                r = mul(r, a);
+        return r;
+    }
+
+    static u32 inverse(u32 a) { return pow(a, P - 2); }
+
+    // w[j] = root^j for j < n / 2, root of order n (or its inverse)
+    static std::vector<u32> twiddles(size_t n, bool invert)
+    {
+        u32 root = pow(G, (P - 1) / n);
+        if (invert)
+            root = inverse(root);
+        std::vector<u32> w(std::max<size_t>(n / 2, 1));
+        w[0] = 1;
+        for (size_t j = 1; j < w.size(); ++j)
+            w[j] = mul(w[j - 1], root);
+        return w;
+    }
+
+    // decimation in frequency, leaves the spectrum in bit reversed order
+    static void forward(u32* a, size_t n)
+    {
+        const auto w = twiddles(n, false);
+        for (size_t len = n / 2, stride = 1; len; len /= 2, stride *= 2)
+        {
+            for (size_t i = 0; i < n; i += 2 * len)
+            {
+                for (size_t j = 0; j < len; ++j)
+                {
+                    const u32 u = a[i + j], v = a[i + j + len];
+                    a[i + j] = add(u, v);
+                    a[i + j + len] = mul(sub(u, v), w[j * stride]);
+                }
+            }
+        }
+    }
+
+    // decimation in time from bit reversed order, includes the 1 / n scaling
+    static void inverse(u32* a, size_t n)
+    {
+        const auto w = twiddles(n, true);
+        for (size_t len = 1, stride = n / 2; len < n; len *= 2, stride /= 2)
+        {
+            for (size_t i = 0; i < n; i += 2 * len)
+            {
+                for (size_t j = 0; j < len; ++j)
+                {
+                    const u32 u = a[i + j], v = mul(a[i + j + len], w[j * stride]);
+                    a[i + j] = add(u, v);
+                    a[i + j + len] = sub(u, v);
+                }
+            }
+        }
+        const u32 scale = inverse(u32(n % P));
+        for (size_t i = 0; i < n; ++i)
+            a[i] = mul(a[i], scale);
+    }
+
+    // c[0..n) = cyclic convolution of a and b modulo P, b == nullptr squares a
+    static void convolve(std::vector<u32>& c, u32 const* a, size_t an, u32 const* b, size_t bn, size_t n)
+    {
+        c.assign(n, 0);
+        for (size_t i = 0; i < an; ++i)
+            c[i] = a[i] % P;
+        forward(c.data(), n);
+
+        if (b)
+        {
+            std::vector<u32> d(n, 0);
+            for (size_t i = 0; i < bn; ++i)
+                d[i] = b[i] % P;
+            forward(d.data(), n);
+            for (size_t i = 0; i < n; ++i)
+                c[i] = mul(c[i], d[i]);
+        }
+        else
+        {
+            for (size_t i = 0; i < n; ++i)
+                c[i] = mul(c[i], c[i]);
+        }
+        inverse(c.data(), n);
+    }
+};
+
+using p0 = field<998244353, 3>;
+using p1 = field<167772161, 3>;
+using p2 = field<469762049, 3>;
+
+// longest supported transform
+// both limits may be lowered but never raised, the fuzz bench does that to reach 16 bit pieces and the fallback with small operands
+inline size_t max_length = size_t(1) << std::min({ p0::two_adicity, p1::two_adicity, p2::two_adicity });
+
+// longest transform for which coefficients of 32 bit pieces stay below p0 * p1 * p2 ~ 2^85.9
+inline size_t max_length_32 = size_t(1) << 21;
+
+// transforms from this length on run the three primes on separate threads
+inline size_t parallel_threshold = size_t(1) << 16;
+
+inline size_t transform_length(size_t n)
+{
+    return std::bit_ceil(std::max<size_t>(n, 1));
+}
+
+// whether pieces of piece_bits bits with a product of n pieces can be multiplied exactly
+inline bool fits(size_t n, int piece_bits)
+{
+    const size_t len = transform_length(n);
+    return len <= max_length && (piece_bits <= 16 || len <= max_length_32);
+}
+
+// r[0..an+bn) = a * b for little endian pieces of piece_bits bits, b == nullptr squares a (bn is ignored)
+inline void multiply(u32* r, u32 const* a, size_t an, u32 const* b, size_t bn, int piece_bits)
+{
+    if (!b)
+        bn = an;
+    assert(fits(an + bn, piece_bits));
+    const size_t n = transform_length(an + bn);
+
+    std::vector<u32> c0, c1, c2;
+    if (n >= parallel_threshold)
+    {
+        std::thread t1([&] { p1::convolve(c1, a, an, b, bn, n); });
+        std::thread t2([&] { p2::convolve(c2, a, an, b, bn, n); });
+        p0::convolve(c0, a, an, b, bn, n);
+        t1.join();
+        t2.join();
+    }
+    else
+    {
+        p0::convolve(c0, a, an, b, bn, n);
+        p1::convolve(c1, a, an, b, bn, n);
+        p2::convolve(c2, a, an, b, bn, n);
+    }
+
+    // garner: x = x0 + p0 * (t1 + p1 * t2)
+    static const u32 inv_p0_mod_p1 = p1::inverse(p0::mod % p1::mod);
+    static const u32 inv_p0p1_mod_p2 = p2::inverse(p2::mul(p0::mod % p2::mod, p1::mod % p2::mod));
+    static constexpr u64 p0p1 = u64(p0::mod) * p1::mod;
+    const u32 piece_mask = piece_bits < 32 ? (u32(1) << piece_bits) - 1 : ~u32(0);
+
+    // carry as a 96 bit number in three 32 bit words
+    u32 carry[3] = {};
+    for (size_t i = 0; i < an + bn; ++i)
+    {
+        const u32 x0 = c0[i];
+        const u32 t1 = p1::mul(p1::sub(c1[i], x0 % p1::mod), inv_p0_mod_p1);
+        const u64 x01 = x0 + u64(p0::mod) * t1;
+        const u32 t2 = p2::mul(p2::sub(c2[i], u32(x01 % p2::mod)), inv_p0p1_mod_p2);
+
+        // v = x01 + p0p1 * t2 + carry
+        const u64 lo = (p0p1 & 0xffffffff) * t2;
+        const u64 hi = (p0p1 >> 32) * t2;
+        u64 w0 = (x01 & 0xffffffff) + (lo & 0xffffffff) + carry[0];
+        u64 w1 = (x01 >> 32) + (lo >> 32) + (hi & 0xffffffff) + carry[1] + (w0 >> 32);
+        u64 w2 = (hi >> 32) + carry[2] + (w1 >> 32);
+        w0 &= 0xffffffff;
+        w1 &= 0xffffffff;
+
+        r[i] = u32(w0) & piece_mask;
+        if (32 == piece_bits)
+        {
+            carry[0] = u32(w1);
+            carry[1] = u32(w2);
+            carry[2] = 0;
+        }
+        else
+        {
+            carry[0] = u32((w0 >> piece_bits) | (w1 << (32 - piece_bits)));
+            carry[1] = u32((w1 >> piece_bits) | (w2 << (32 - piece_bits)));
+            carry[2] = u32(w2 >> piece_bits);
+        }
+    }
+    assert(!carry[0] && !carry[1] && !carry[2]);
+}
+
+}
+
+}
@@ -1,23 +1,88 @@
 #pragma once
 
 #include <defines.hpp>
+#include <small_vector.hpp>
+#include <ntt.hpp>
+#include <deque>
 #include <string>
+#include <string_view>
 
+#include <algorithm>
 #include <bit>
+#include <compare>
+
+// digit width of num, 64 bit digits need either unsigned __int128 or the msvc x64 intrinsics
+#ifndef ER_NUM_DIGIT_BITS
+#if defined(__SIZEOF_INT128__) || defined(_M_X64)
+#define ER_NUM_DIGIT_BITS 64
+#else
+#define ER_NUM_DIGIT_BITS 32
+#endif
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define ER_NUM_X64_INTRINSICS 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// digits stored inline before num spills to the heap
+#ifndef ER_NUM_INLINE_DIGITS
+#define ER_NUM_INLINE_DIGITS 4
+#endif
+
+#ifndef ER_NUM_NEWTON_DIVISION_THRESHOLD
+#define ER_NUM_NEWTON_DIVISION_THRESHOLD 1000
+#endif
+
+#ifndef ER_NUM_KARATSUBA_THRESHOLD
+#define ER_NUM_KARATSUBA_THRESHOLD 32
+#endif
+
+#ifndef ER_NUM_TOOM3_THRESHOLD
+#define ER_NUM_TOOM3_THRESHOLD 256
+#endif
+
+// the transform works on 32 bit pieces, so its crossover in digits depends on the digit width
+#ifndef ER_NUM_NTT_THRESHOLD
+#if 64 == ER_NUM_DIGIT_BITS
+#define ER_NUM_NTT_THRESHOLD 2048
+#else
+#define ER_NUM_NTT_THRESHOLD 1024
+#endif
+#endif
 
 namespace er
 {
 
+#if 64 == ER_NUM_DIGIT_BITS
+using digit  = u64;
+#if defined(__SIZEOF_INT128__)
+#define ER_NUM_HAS_DIGIT2 1
+using digit2 = unsigned __int128;
+#elif !defined(ER_NUM_X64_INTRINSICS)
+#error "64 bit num digits need unsigned __int128 or x64 intrinsics"
+#endif
+#elif 32 == ER_NUM_DIGIT_BITS
+#define ER_NUM_HAS_DIGIT2 1
 using digit  = u32;
 using digit2 = u64;
+#else
+#error "ER_NUM_DIGIT_BITS must be 32 or 64"
+#endif
 
 struct num
 {
-    static constexpr u64   bits = 32;
+    static constexpr u64   bits = sizeof(digit) * 8;
     static constexpr digit mask = ~digit(0u);
 
+    using digits = small_vector<digit, ER_NUM_INLINE_DIGITS>;
+
     digit extension = 0;
-    std::vector<digit> data;
+    digits data;
     
     constexpr num() = default;
 
@@ -49,11 +114,460 @@ struct num
 			data.pop_back();
 	}
 
+    // a + b + c, c is the carry in and out
     static digit adc(digit a, digit b, digit& c)
     {
-        digit2 r = digit2(a & mask) + digit2(b & mask) + digit2(c & 1);
-        c = (r >> bits) & 1;
-        return r & mask;
+#if 64 == ER_NUM_DIGIT_BITS && defined(ER_NUM_X64_INTRINSICS)
+        unsigned long long r;
+        c = _addcarry_u64((unsigned char)c, a, b, &r);
+        return r;
+#else
+        digit2 r = digit2(a) + digit2(b) + digit2(c);
+        c = digit(r >> bits);
+        return digit(r);
+#endif
+    }
+
+    // a - b - c, c is the borrow in and out
+    static digit sbb(digit a, digit b, digit& c)
+    {
+#if 64 == ER_NUM_DIGIT_BITS && defined(ER_NUM_X64_INTRINSICS)
+        unsigned long long r;
+        c = _subborrow_u64((unsigned char)c, a, b, &r);
+        return r;
+#else
+        digit2 r = digit2(a) - digit2(b) - digit2(c);
+        c = digit(r >> bits) & 1;
+        return digit(r);
+#endif
+    }
+
+    // a * b, returns the low digit and stores the high one in hi
+    static digit mul_wide(digit a, digit b, digit& hi)
+    {
+#if defined(ER_NUM_HAS_DIGIT2)
+        digit2 r = digit2(a) * digit2(b);
+        hi = digit(r >> bits);
+        return digit(r);
+#else
+        unsigned long long h;
+        digit lo = _umul128(a, b, &h);
+        hi = h;
+        return lo;
+#endif
+    }
+
+    // (hi * B + lo) / d, requires hi < d
+    static digit div_wide(digit hi, digit lo, digit d, digit& rem)
+    {
+        assert(hi < d);
+#if defined(ER_NUM_HAS_DIGIT2)
+        digit2 t = (digit2(hi) << bits) | lo;
+        rem = digit(t % d);
+        return digit(t / d);
+#else
+        unsigned long long r;
+        digit q = _udiv128(hi, lo, d, &r);
+        rem = r;
+        return q;
+#endif
+    }
+
+    // crossover sizes (in digits of the shorter operand) for the multiplication dispatch
+    static inline size_t karatsuba_threshold = ER_NUM_KARATSUBA_THRESHOLD;
+    static inline size_t toom3_threshold     = ER_NUM_TOOM3_THRESHOLD;
+    static inline size_t ntt_threshold       = ER_NUM_NTT_THRESHOLD;
+
+    // divisor and quotient length from which division goes through a newton reciprocal
+    static inline size_t newton_division_threshold = ER_NUM_NEWTON_DIVISION_THRESHOLD;
+
+    // digit kernels
+    // operate on little endian magnitudes, output may alias the first input
+
+    static int cmp(digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        while (an > bn) if (a[--an]) return 1;
+        while (bn > an) if (b[--bn]) return -1;
+        while (an--)
+            if (a[an] != b[an])
+                return a[an] < b[an] ? -1 : 1;
+        return 0;
+    }
+
+    // r[0..an) = a + b, requires an >= bn, returns carry
+    static digit add(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        assert(an >= bn);
+        digit carry = 0;
+        size_t i = 0;
+        for (; i < bn; ++i)
+            r[i] = adc(a[i], b[i], carry);
+        for (; i < an; ++i)
+            r[i] = adc(a[i], 0, carry);
+        return carry;
+    }
+
+    // r[0..an) = a - b, requires an >= bn, returns borrow
+    static digit sub(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        assert(an >= bn);
+        digit borrow = 0;
+        size_t i = 0;
+        for (; i < bn; ++i)
+            r[i] = sbb(a[i], b[i], borrow);
+        for (; i < an; ++i)
+            r[i] = sbb(a[i], 0, borrow);
+        return borrow;
+    }
+
+    // r[0..an) = |a - b|, requires an >= bn, returns true if a < b
+    static bool abs_diff(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        if (cmp(a, an, b, bn) >= 0)
+        {
+            sub(r, a, an, b, bn);
+            return false;
+        }
+        // a < b so the digits of a above bn are zero
+        sub(r, b, bn, a, bn);
+        std::fill(r + bn, r + an, digit(0));
+        return true;
+    }
+
+    // r[0..n) += a * m, returns carry
+    static digit addmul_1(digit* r, digit const* a, size_t n, digit m)
+    {
+        digit carry = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            digit hi, c = 0;
+            digit lo = adc(mul_wide(a[i], m, hi), carry, c);
+            hi += c;
+            c = 0;
+            r[i] = adc(r[i], lo, c);
+            carry = hi + c;
+        }
+        return carry;
+    }
+
+    // r[0..n) = a * m, returns carry
+    static digit mul_1(digit* r, digit const* a, size_t n, digit m)
+    {
+        digit carry = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            digit hi, c = 0;
+            r[i] = adc(mul_wide(a[i], m, hi), carry, c);
+            carry = hi + c;
+        }
+        return carry;
+    }
+
+    // q[0..n) = a / d, returns a % d
+    static digit divrem_1(digit* q, digit const* a, size_t n, digit d)
+    {
+        digit rem = 0;
+        while (n--)
+            q[n] = div_wide(rem, a[n], d, rem);
+        return rem;
+    }
+
+    // r[0..n) -= a * m, returns borrow
+    static digit submul_1(digit* r, digit const* a, size_t n, digit m)
+    {
+        digit carry = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            digit hi, c = 0;
+            digit lo = adc(mul_wide(a[i], m, hi), carry, c);
+            hi += c;
+            c = 0;
+            r[i] = sbb(r[i], lo, c);
+            carry = hi + c;
+        }
+        return carry;
+    }
+
+    // r[0..n) = a << s, requires s < bits, returns the bits shifted out
+    static digit lshift(digit* r, digit const* a, size_t n, int s)
+    {
+        if (0 == s)
+        {
+            std::copy(a, a + n, r);
+            return 0;
+        }
+        digit out = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const digit v = a[i];
+            r[i] = ((v << s) | out) & mask;
+            out = v >> (bits - s);
+        }
+        return out;
+    }
+
+    // r[0..n) = a >> s, requires s < bits
+    static void rshift(digit* r, digit const* a, size_t n, int s)
+    {
+        if (0 == s)
+        {
+            std::copy(a, a + n, r);
+            return;
+        }
+        for (size_t i = 0; i < n; ++i)
+            r[i] = ((a[i] >> s) | (i + 1 < n ? a[i + 1] << (bits - s) : 0)) & mask;
+    }
+
+    // r[0..an+bn) = a * b
+    static void mul_basecase(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        std::fill(r, r + an + bn, digit(0));
+        for (size_t i = 0; i < an; ++i)
+            r[i + bn] = addmul_1(r + i, b, bn, a[i]);
+    }
+
+    // r[0..2n) = a * a, each cross product is formed once and doubled
+    static void sqr_basecase(digit* r, digit const* a, size_t n)
+    {
+        std::fill(r, r + 2 * n, digit(0));
+        for (size_t i = 0; i + 1 < n; ++i)
+            r[i + n] = addmul_1(r + 2 * i + 1, a + i + 1, n - i - 1, a[i]);
+        lshift(r, r, 2 * n, 1);
+
+        digit carry = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            digit hi, lo = mul_wide(a[i], a[i], hi);
+            r[2 * i] = adc(r[2 * i], lo, carry);
+            r[2 * i + 1] = adc(r[2 * i + 1], hi, carry);
+        }
+    }
+
+    // r[0..2n) = a * a, r must not alias a
+    static void sqr(digit* r, digit const* a, size_t n)
+    {
+        if (n < std::max<size_t>(karatsuba_threshold, 2))
+            return sqr_basecase(r, a, n);
+        mul(r, a, n, a, n);
+    }
+
+    // same as sqr, tmp holds mul_scratch(n, n) digits
+    static void sqr(digit* r, digit const* a, size_t n, digit* tmp)
+    {
+        if (n < std::max<size_t>(karatsuba_threshold, 2))
+            return sqr_basecase(r, a, n);
+        mul(r, a, n, a, n, tmp);
+    }
+
+    // digits of tmp an a * b product needs, requires an >= bn
+    // a karatsuba or slicing level on a longer operand of m digits takes at most 3m + 4 and hands on at most (m + 1) / 2,
+    // toom3 and ntt bring their own
+    static size_t mul_scratch(size_t an, size_t bn)
+    {
+        if (bn < std::max<size_t>(karatsuba_threshold, 2))
+            return 0;
+        if (2 * bn > an + 1 && bn >= std::max<size_t>(toom3_threshold, 3))
+            return 0;
+        size_t res = 0, m = an;
+        if (2 * bn <= an + 1)
+        {
+            res = 2 * bn;
+            m = bn;
+        }
+        for (; m >= std::max<size_t>(karatsuba_threshold, 2); m = (m + 1) / 2)
+            res += 3 * m + 4;
+        return res;
+    }
+
+    // r[0..an+bn) = a * b, requires an >= bn > (an + 1) / 2, tmp holds mul_scratch(an, bn) digits
+    static void mul_karatsuba(digit* r, digit const* a, size_t an, digit const* b, size_t bn, digit* tmp)
+    {
+        // a = a1 * B^h + a0, b = b1 * B^h + b0
+        // a * b = z2 * B^2h + (z0 + z2 - (a0 - a1)(b0 - b1)) * B^h + z0
+        const size_t h = (an + 1) / 2;
+        const size_t ah = an - h;
+        const size_t bh = bn - h;
+        assert(bh > 0 && ah >= bh);
+
+        digit* da = tmp;
+        digit* db = da + h;
+        digit* z1 = db + h;
+        digit* m = z1 + 2 * h;
+        digit* next = m + 2 * h + 1;
+
+        const bool neg = abs_diff(da, a, h, a + h, ah) != abs_diff(db, b, h, b + h, bh);
+
+        mul(r, a, h, b, h, next);
+        mul(r + 2 * h, a + h, ah, b + h, bh, next);
+        mul(z1, da, h, db, h, next);
+
+        std::copy(r, r + 2 * h, m);
+        m[2 * h] = add(m, m, 2 * h, r + 2 * h, ah + bh);
+        if (neg)
+            add(m, m, 2 * h + 1, z1, 2 * h);
+        else
+            sub(m, m, 2 * h + 1, z1, 2 * h);
+
+        size_t mn = 2 * h + 1;
+        while (mn && !m[mn - 1])
+            --mn;
+        assert(mn <= an + bn - h);
+        add(r + h, r + h, an + bn - h, m, mn);
+    }
+
+    // r[0..an+bn) = a * b, requires an >= bn, splits both operands in three and recombines through num
+    static void mul_toom3(digit* r, digit const* a, size_t an, digit const* b, size_t bn);
+
+    // r[0..an+bn) = a * b through a three prime ntt, a == b and an == bn squares with one forward transform
+    // returns false if the product is too long for the transform
+    static bool mul_ntt(digit* r, digit const* a, size_t an, digit const* b, size_t bn);
+
+    // r[0..an+bn) = a * b, requires an >= bn, r must not alias a or b
+    // the scratch for the whole recursion is allocated once here
+    static void mul(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        digits tmp(mul_scratch(an, bn));
+        mul(r, a, an, b, bn, tmp.data());
+    }
+
+    // same as mul, tmp holds mul_scratch(an, bn) digits
+    static void mul(digit* r, digit const* a, size_t an, digit const* b, size_t bn, digit* tmp)
+    {
+        assert(an >= bn);
+        if (bn < std::max<size_t>(karatsuba_threshold, 2))
+            return mul_basecase(r, a, an, b, bn);
+
+        if (bn >= ntt_threshold && mul_ntt(r, a, an, b, bn))
+            return;
+
+        if (2 * bn <= an + 1)
+        {
+            // unbalanced: multiply b by bn sized slices of a
+            std::fill(r, r + an + bn, digit(0));
+            digit* t = tmp;
+            for (size_t i = 0; i < an; i += bn)
+            {
+                const size_t n = std::min(bn, an - i);
+                mul(t, b, bn, a + i, n, t + 2 * bn);
+                add(r + i, r + i, an + bn - i, t, bn + n);
+            }
+            return;
+        }
+
+        if (bn >= std::max<size_t>(toom3_threshold, 3))
+            return mul_toom3(r, a, an, b, bn);
+        mul_karatsuba(r, a, an, b, bn, tmp);
+    }
+
+    // q[0..an-bn] = a / b, rem[0..bn) = a % b, requires an >= bn and b[bn-1] != 0
+    static void divrem(digit* q, digit* rem, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        assert(an >= bn && bn > 0 && b[bn - 1]);
+        if (1 == bn)
+            rem[0] = divrem_1(q, a, an, b[0]);
+        else if (bn >= newton_division_threshold && an - bn >= newton_division_threshold)
+            divrem_newton(q, rem, a, an, b, bn);
+        else
+            divrem_knuth(q, rem, a, an, b, bn);
+    }
+
+    // same contract as divrem with bn > 1
+    // Knuth, TAOCP vol. 2, 4.3.1 algorithm D
+    static void divrem_knuth(digit* q, digit* rem, digit const* a, size_t an, digit const* b, size_t bn)
+    {
+        assert(bn > 1);
+
+        // normalize so the top digit of the divisor has its high bit set
+        const int s = int(bits) - num_bits(b[bn - 1]);
+        digits un(an + 1), vn(bn);
+        lshift(vn.data(), b, bn, s);
+        un[an] = lshift(un.data(), a, an, s);
+
+        const digit v1 = vn[bn - 1];
+        const digit v2 = vn[bn - 2];
+        for (size_t j = an - bn + 1; j--;)
+        {
+            digit* u = un.data() + j;
+
+            // estimate the quotient digit from the top two digits, it is at most two too large
+            digit qhat, rhat, overflow = 0;
+            if (u[bn] >= v1)
+            {
+                qhat = mask;
+                rhat = adc(u[bn - 1], v1, overflow);
+            }
+            else
+                qhat = div_wide(u[bn], u[bn - 1], v1, rhat);
+
+            while (!overflow)
+            {
+                digit hi, lo = mul_wide(qhat, v2, hi);
+                if (hi < rhat || (hi == rhat && lo <= u[bn - 2]))
+                    break;
+                --qhat;
+                rhat = adc(rhat, v1, overflow);
+            }
+
+            const digit borrow = submul_1(u, vn.data(), bn, digit(qhat));
+            const bool negative = u[bn] < borrow;
+            u[bn] = (u[bn] - borrow) & mask;
+            if (negative)
+            {
+                // qhat was one too large, add the divisor back
+                --qhat;
+                u[bn] = (u[bn] + add(u, u, bn, vn.data(), bn)) & mask;
+            }
+            q[j] = qhat;
+        }
+        rshift(rem, un.data(), bn, s);
+    }
+
+    // floor(B^2n / d) for d with n digits
+    static num reciprocal(num const& d);
+
+    // same contract as divrem, multiplies by the reciprocal of b
+    static void divrem_newton(digit* q, digit* rem, digit const* a, size_t an, digit const* b, size_t bn);
+
+    // n * B^k, k may be negative which truncates towards minus infinity
+    static num shift_digits(num const& n, ptrdiff_t k)
+    {
+        if (k < 0)
+        {
+            num res;
+            res.extension = n.extension;
+            if (size_t(-k) < n.data.size())
+                res.data.assign(n.data.begin() - k, n.data.end());
+            res.canonicalize();
+            return res;
+        }
+        if (n.data.empty() && !n.extension)
+            return n;
+        num res;
+        res.extension = n.extension;
+        res.data.resize(k + n.data.size());
+        std::copy(n.data.begin(), n.data.end(), res.data.begin() + k);
+        res.canonicalize();
+        return res;
+    }
+
+    static num from_digits(digit const* p, size_t n)
+    {
+        num res;
+        res.data.assign(p, p + n);
+        res.canonicalize();
+        return res;
+    }
+
+    // exact division of a signed number by a single digit
+    static num divexact_1(num const& n, digit d)
+    {
+        if (n.extension)
+            return -divexact_1(-n, d);
+        num q = n;
+        [[maybe_unused]] digit rem = divrem_1(q.data.data(), q.data.data(), q.data.size(), d);
+        assert(0 == rem);
+        q.canonicalize();
+        return q;
     }
 
     friend num operator ~(num const& n)
@@ -66,11 +580,95 @@ struct num
 		return res;
     }
 
+    template<class Op>
+    static num bitwise(num const& l, num const& r, Op op)
+    {
+        num res;
+        res.data.resize(std::max(l.data.size(), r.data.size()));
+        for (size_t i = 0; i < res.data.size(); ++i)
+            res.data[i] = op(l.get(i), r.get(i)) & mask;
+        res.extension = op(l.extension, r.extension) & mask;
+        res.canonicalize();
+        return res;
+    }
+
+    // bitwise operators act on the infinite two's complement representation
+    friend num operator &(num const& l, num const& r) { return bitwise(l, r, [](digit a, digit b) { return a & b; }); }
+    friend num operator |(num const& l, num const& r) { return bitwise(l, r, [](digit a, digit b) { return a | b; }); }
+    friend num operator ^(num const& l, num const& r) { return bitwise(l, r, [](digit a, digit b) { return a ^ b; }); }
+
+    friend num& operator &=(num& l, num const& r) { return l = l & r; }
+    friend num& operator |=(num& l, num const& r) { return l = l | r; }
+    friend num& operator ^=(num& l, num const& r) { return l = l ^ r; }
+
+    // n * 2^s
+    friend num operator <<(num const& n, size_t s)
+    {
+        if (n.data.empty() && !n.extension)
+            return n;
+        num res;
+        res.extension = n.extension;
+        const size_t k = s / bits;
+        const size_t len = n.data.size() + 1;
+        res.data.resize(k + len);
+        digit* p = res.data.data() + k;
+        std::copy(n.data.begin(), n.data.end(), p);
+        p[len - 1] = n.extension;
+        lshift(p, p, len, int(s % bits));
+        res.canonicalize();
+        return res;
+    }
+
+    // floor(n / 2^s)
+    friend num operator >>(num const& n, size_t s)
+    {
+        num res;
+        res.extension = n.extension;
+        const size_t k = s / bits;
+        if (k >= n.data.size())
+            return res;
+        res.data.assign(n.data.begin() + k, n.data.end());
+        res.data.push_back(n.extension);
+        rshift(res.data.data(), res.data.data(), res.data.size(), int(s % bits));
+        res.data.pop_back();
+        res.canonicalize();
+        return res;
+    }
+
+    friend num& operator <<=(num& n, size_t s) { return n = n << s; }
+    friend num& operator >>=(num& n, size_t s) { return n = n >> s; }
+
     friend num operator - (num const& n)
 	{
-		return ~n + 1;
+        num res = n;
+        res.negate();
+		return res;
 	}
 
+    // two's complement negation in place
+    num& negate()
+    {
+        digit carry = 1;
+        for (auto& d : data)
+            d = adc(~d & mask, 0, carry);
+        extension = (~extension) & mask;
+        if (carry)
+        {
+            // the carry runs into the extension
+            if (extension)
+                extension = 0;
+            else
+                data.push_back(1);
+        }
+        canonicalize();
+        return *this;
+    }
+
+    num& abs()
+    {
+        return extension ? negate() : *this;
+    }
+
     friend bool operator == (num const& l, num const& r)
     {
         assert(l.is_cannon() && r.is_cannon());
@@ -81,63 +679,119 @@ struct num
     {
         return !(l==r);
     }
-    
-    friend num operator - (num const& l, num const& r)
-    {
-        return l + (-r);
-    }
 
-    friend num operator + (num const& l, num const& r)
+    friend std::strong_ordering operator <=>(num const& l, num const& r)
     {
-        const size_t len = std::max(l.data.size(), r.data.size()) + 1;
-        num res;
-        res.data.resize(len);
-        digit carry = 0;
-        for (int i = 0; i < len; ++i)
-            res.data[i] = adc(l.get(i), r.get(i), carry);
+        if (l.extension != r.extension)
+            return l.extension ? std::strong_ordering::less : std::strong_ordering::greater;
 
-        if (l.extension == r.extension)
+        // with equal signs two's complement orders like the unsigned digits
+        for (size_t i = std::max(l.data.size(), r.data.size()); i--;)
         {
-            res.extension = l.extension;
-            if(carry && 0 == res.extension)
-                res.data.push_back(carry);
+            const digit a = l.get(i), b = r.get(i);
+            if (a != b)
+                return a < b ? std::strong_ordering::less : std::strong_ordering::greater;
         }
-        else
-            res.extension = carry ? digit(0) : mask;
+        return std::strong_ordering::equal;
+    }
 
-        res.canonicalize();
-        return res;
+    // this += r, or this -= r as this + ~r + 1
+    void add_assign(num const& r, bool subtract)
+    {
+        const digit flip = subtract ? mask : 0;
+        const digit r_extension = r.extension ^ flip;
+        const size_t n = std::max(data.size(), r.data.size());
+        data.resize(n, extension);
+
+        digit carry = subtract ? 1 : 0;
+        for (size_t i = 0; i < n; ++i)
+            data[i] = adc(data[i], r.get(i) ^ flip, carry);
+
+        // one more digit holds the exact result, its top bit is the sign
+        const digit top = adc(extension, r_extension, carry);
+        extension = (top >> (bits - 1)) ? mask : 0;
+        if (top != extension)
+            data.push_back(top);
+        canonicalize();
+    }
+
+    friend num& operator +=(num& l, num const& r)
+    {
+        l.add_assign(r, false);
+        return l;
+    }
+
+    friend num& operator -=(num& l, num const& r)
+    {
+        l.add_assign(r, true);
+        return l;
+    }
+
+    friend num operator - (num const& l, num const& r)
+    {
+        num res = l;
+        return res -= r;
+    }
+
+    friend num operator + (num const& l, num const& r)
+    {
+        num res = l;
+        return res += r;
     }
 
     friend num abs(num const& n)
     {
-        return n.extension ? -n : n;
+        num res = n;
+        return res.abs();
+    }
+
+    friend num& operator *=(num& l, num const& r)
+    {
+        if (&l == &r)
+            return l = l * r;
+
+        const bool negative = (l.extension ^ r.extension) != 0;
+        num nr;
+        num const& b = r.extension ? (nr = -r) : r;
+        l.abs();
+
+        if (b.data.size() <= 1)
+        {
+            const digit m = b.data.empty() ? 0 : b.data[0];
+            const digit carry = mul_1(l.data.data(), l.data.data(), l.data.size(), m);
+            if (carry)
+                l.data.push_back(carry);
+        }
+        else if (!l.data.empty())
+        {
+            digits res(l.data.size() + b.data.size());
+            if (l.data.size() >= b.data.size())
+                mul(res.data(), l.data.data(), l.data.size(), b.data.data(), b.data.size());
+            else
+                mul(res.data(), b.data.data(), b.data.size(), l.data.data(), l.data.size());
+            l.data = std::move(res);
+        }
+        l.canonicalize();
+        return negative ? l.negate() : l;
     }
 
     friend num operator *(num const& l, num const& r)
     {
-        if(l.extension && r.extension)
-            return -l * -r;
-        if(l.extension)
-            return -(-l * r);
-        if(r.extension)
-            return -(l * -r);
+        num nl, nr;
+        num const& a = l.extension ? (nl = -l) : l;
+        num const& b = &l == &r ? a : r.extension ? (nr = -r) : r;
+        if (a.data.empty() || b.data.empty())
+            return 0;
 
         num res;
-		res.data.resize(l.data.size() + r.data.size());
-		for (size_t i = 0; i < l.data.size(); ++i)
-		{
-			digit carry = 0;
-			for (size_t j = 0; j < r.data.size(); ++j)
-			{
-				digit2 t = digit2(l.data[i]) * digit2(r.data[j]) + digit2(res.data[i + j]) + carry;
-				res.data[i + j] = t & mask;
-				carry = (t >> bits) & mask;
-			}
-			res.data[i + r.data.size()] = carry;
-		}
-        res.extension = (l.extension ^ r.extension) & mask;
+		res.data.resize(a.data.size() + b.data.size());
+        if (a.data.size() >= b.data.size())
+            mul(res.data.data(), a.data.data(), a.data.size(), b.data.data(), b.data.size());
+        else
+            mul(res.data.data(), b.data.data(), b.data.size(), a.data.data(), a.data.size());
 		res.canonicalize();
+        if (l.extension ^ r.extension)
+            res.negate();
 		return res;
     }
 
@@ -155,53 +809,50 @@ struct num
         return (n.data.size() - 1) * bits + num_bits(n.data.back());
     }
 
-    friend bool operator <(num const& l, num const& r)
+    static int bit_diff(num const& l, num const& r)
     {
-        if(l.extension && r.extension)
-			return -l > -r;
-		if(l.extension)
-			return true;
-		if(r.extension)
-			return false;
-
-		if(l.data.size() != r.data.size())
-			return l.data.size() < r.data.size();
-
-		for (int i = l.data.size() - 1; i >= 0; --i)
-		{
-			if(l.data[i] != r.data[i])
-				return l.data[i] < r.data[i];
-		}
-		return false;
+        return num_bits(l) - num_bits(r);
     }
 
-    friend bool operator >(num const& l, num const& r)
+    // bits in the shortest two's complement representation of n, not counting the sign
+    friend size_t bit_length(num const& n)
     {
-		if(l.extension && r.extension)
-			return -l < -r;
-		if(l.extension)
-			return false;
-		if(r.extension)
-			return true;
-
-		if(l.data.size() != r.data.size())
-			return l.data.size() > r.data.size();
+        if (n.data.empty())
+            return 0;
+        return (n.data.size() - 1) * bits + size_t(num_bits(n.data.back() ^ n.extension));
+    }
 
-		for (int i = l.data.size() - 1; i >= 0; --i)
-		{
-			if(l.data[i] != r.data[i])
-				return l.data[i] > r.data[i];
-		}
-		return false;
+    // number of trailing zero bits, 0 for n == 0
+    friend size_t countr_zero(num const& n)
+    {
+        for (size_t i = 0; i < n.data.size(); ++i)
+            if (n.data[i])
+                return i * bits + size_t(std::countr_zero(n.data[i]));
+        return 0;
     }
 
-    static int bit_diff(num const& l, num const& r)
+    // number of bits that differ from the sign bit
+    friend size_t popcount(num const& n)
     {
-        return num_bits(l) - num_bits(r);
+        size_t res = 0;
+        for (digit d : n.data)
+            res += size_t(std::popcount(digit(d ^ n.extension)));
+        return res;
     }
 
-    friend num& operator -=(num& l, num const& r) { return l = l - r; }
-    friend num& operator +=(num& l, num const& r) { return l = l + r; }
+    // n mod 2^s for non-negative n
+    static num low_bits(num const& n, size_t s)
+    {
+        assert(!n.extension);
+        const size_t k = s / bits;
+        if (k >= n.data.size())
+            return n;
+        num res;
+        res.data.assign(n.data.begin(), n.data.begin() + k + 1);
+        res.data.back() &= (digit(1) << (s % bits)) - 1;
+        res.canonicalize();
+        return res;
+    }
 
     friend num operator/(num const& a, num const& b)
     {
@@ -216,131 +867,569 @@ struct num
         return r;
     }
 
-    friend num gcd(num const& a, num const& b)
+    static digit binary_gcd(digit a, digit b)
     {
-        if(a.extension && b.extension) return gcd(-a, -b);
-        if(a.extension) return gcd(-a, b);
-        if(b.extension) return gcd(a, -b);
+        if (!a || !b)
+            return a | b;
+        const int s = std::countr_zero(a | b);
+        a >>= std::countr_zero(a);
+        do
+        {
+            b >>= std::countr_zero(b);
+            if (a > b)
+                std::swap(a, b);
+            b -= a;
+        } while (b);
+        return a << s;
+    }
 
-        if(0 == b) return a;
-        if(0 == a) return b;
-        return gcd(b, a % b);
+    // count bits of the non-negative n starting at bit pos
+    static digit extract_bits(num const& n, size_t pos, int count)
+    {
+        const size_t i = pos / bits;
+        const int off = int(pos % bits);
+        digit v = n.get(i) >> off;
+        if (off)
+            v |= n.get(i + 1) << (bits - off);
+        return count < int(bits) ? v & ((digit(1) << count) - 1) : v;
     }
 
-    friend num divmod(num const& a, num const& b, num& r)
+    // r = a * u - b * v, requires the result to be non-negative
+    static void mul_sub_1(digits& r, digits& t, num const& u, digit a, num const& v, digit b)
+    {
+        const size_t n = std::max(u.data.size(), v.data.size()) + 1;
+        r.resize(n);
+        t.resize(n);
+        std::fill(r.begin(), r.end(), digit(0));
+        std::fill(t.begin(), t.end(), digit(0));
+        r[u.data.size()] = mul_1(r.data(), u.data.data(), u.data.size(), a);
+        t[v.data.size()] = mul_1(t.data(), v.data.data(), v.data.size(), b);
+        [[maybe_unused]] digit borrow = sub(r.data(), r.data(), n, t.data(), n);
+        assert(!borrow);
+    }
+
+    // gcd of the non-negative u and v, if x is given it receives the cofactor of u
+    // Knuth, TAOCP vol. 2, 4.5.2 algorithm L with single digit cofactors
+    static num lehmer_gcd(num u, num v, num* x)
     {
-        if (a.extension && b.extension)
+        using sdigit = std::make_signed_t<digit>;
+        static constexpr int precision = int(bits) - 2;
+
+        num su = 1, sv = 0;
+        digits r0, r1, t;
+        while (true)
         {
-            auto q = divmod(-a, b, r);
-            r = -r;
-            return q;
+            if (u < v)
+            {
+                std::swap(u, v);
+                std::swap(su, sv);
+            }
+            if (v.data.empty())
+                break;
+
+            if (!x && u.data.size() <= 1)
+                return num(binary_gcd(u.get(0), v.get(0)));
+
+            sdigit A = 1, B = 0, C = 0, D = 1;
+            if (v.data.size() > 1)
+            {
+                // run euclid on the leading bits while the quotients agree with the full numbers
+                const size_t pos = num_bits(u) - precision;
+                sdigit xh = sdigit(extract_bits(u, pos, precision));
+                sdigit yh = sdigit(extract_bits(v, pos, precision));
+                while (yh + C && yh + D)
+                {
+                    const sdigit q = (xh + A) / (yh + C);
+                    if (q != (xh + B) / (yh + D))
+                        break;
+                    sdigit T = A - q * C; A = C; C = T;
+                    T = B - q * D; B = D; D = T;
+                    T = xh - q * yh; xh = yh; yh = T;
+                }
+            }
+
+            if (0 == B)
+            {
+                // no progress on the leading bits, do a full division step
+                num rem;
+                num q = divmod(u, v, rem);
+                u = std::move(v);
+                v = std::move(rem);
+                if (x)
+                {
+                    su -= q * sv;
+                    std::swap(su, sv);
+                }
+                continue;
+            }
+
+            // (u, v) = (A u + B v, C u + D v), each pair of cofactors has opposite signs
+            auto combine = [&](digits& r, sdigit a, sdigit b)
+            {
+                if (a >= 0 && b <= 0)
+                    mul_sub_1(r, t, u, digit(a), v, digit(-b));
+                else
+                    mul_sub_1(r, t, v, digit(b), u, digit(-a));
+            };
+            combine(r0, A, B);
+            combine(r1, C, D);
+            std::swap(u.data, r0);
+            std::swap(v.data, r1);
+            u.canonicalize();
+            v.canonicalize();
+
+            if (x)
+            {
+                num s = su * A + sv * B;
+                sv = su * C + sv * D;
+                su = std::move(s);
+            }
         }
+        if (x)
+            *x = std::move(su);
+        return u;
+    }
+
+    friend num gcd(num const& a, num const& b)
+    {
+        num u = a, v = b;
+        u.abs();
+        v.abs();
+        if (u.data.empty() || v.data.empty())
+            return u | v;
+
+        // factors of two are shifted out rather than divided out
+        const size_t su = countr_zero(u), sv = countr_zero(v);
+        return lehmer_gcd(u >> su, v >> sv, nullptr) << std::min(su, sv);
+    }
+
+    // returns gcd(a, b) and bezout coefficients with a * x + b * y = gcd(a, b)
+    friend num xgcd(num const& a, num const& b, num& x, num& y)
+    {
+        num u = a, v = b;
+        num g = lehmer_gcd(std::move(u.abs()), std::move(v.abs()), &x);
         if (a.extension)
+            x.negate();
+        y = 0 == b ? num(0) : (g - a * x) / b;
+        return g;
+    }
+
+    // truncating division, the remainder takes the sign of the dividend
+    friend num divmod(num const& a, num const& b, num& r)
+    {
+        assert(0 != b);
+        num na, nb;
+        num const& n = a.extension ? (na = -a) : a;
+        num const& d = b.extension ? (nb = -b) : b;
+
+        if (cmp(n.data.data(), n.data.size(), d.data.data(), d.data.size()) < 0)
         {
-            auto q = divmod(-a, b, r);
-            r = -r;
-            return -q;
+            r = a;
+            return 0;
         }
 
-        if (b.extension)
+        num q, m;
+        if (std::has_single_bit(d.data.back()) && std::all_of(d.data.begin(), d.data.end() - 1, [](digit x) { return !x; }))
         {
-			return -divmod(a, -b, r);
-		}
-
-        if (a == b)
+            // power of two divisor
+            const size_t s = bit_length(d) - 1;
+            q = n >> s;
+            m = low_bits(n, s);
+        }
+        else
         {
-			r = 0;
-			return 1;
-		}
+            q.data.resize(n.data.size() - d.data.size() + 1);
+            m.data.resize(d.data.size());
+            divrem(q.data.data(), m.data.data(), n.data.data(), n.data.size(), d.data.data(), d.data.size());
+            q.canonicalize();
+            m.canonicalize();
+        }
 
-        if (a < b)
+        r = a.extension ? -m : m;
+        return (a.extension ^ b.extension) ? -q : q;
+    }
+
+
+    // radix conversion works in chunks of decimal_chunk_digits decimal digits
+    static constexpr digit  decimal_chunk = 1000000000;
+    static constexpr size_t decimal_chunk_digits = 9;
+
+    // numbers up to this many digits are converted chunk by chunk
+    static inline size_t decimal_basecase_digits = 24;
+
+    // 10^L = 5^L * 2^L with L = decimal_chunk_digits * 2^k, so only the odd part is multiplied or divided
+    static size_t decimal_power_exponent(size_t k)
+    {
+        return decimal_chunk_digits << k;
+    }
+
+    // 5^(decimal_chunk_digits * 2^k), cached per thread
+    static num const& five_power(size_t k)
+    {
+        thread_local std::deque<num> cache;
+        while (cache.size() <= k)
+            cache.push_back(cache.empty() ? num(1953125) : cache.back() * cache.back());
+        return cache[k];
+    }
+
+    template<class Out>
+    static void write_zeros(Out& out, size_t n)
+    {
+        static constexpr char zeros[] = "0000000000000000";
+        for (; n > 16; n -= 16)
+            out(zeros, 16);
+        out(zeros, n);
+    }
+
+    // writes the non-negative n, left padded with zeros to width unless width is 0
+    template<class Out>
+    static void write_decimal(num const& n, Out& out, size_t width)
+    {
+        assert(!n.extension);
+        if (n.data.size() > decimal_basecase_digits)
         {
-			r = a;
-			return 0;
-		}
-        if (b == 1)
+            // split around the largest cached power with at most half the bits of n
+            size_t k = 0;
+            while (2 * (bit_length(five_power(k + 1)) + decimal_power_exponent(k + 1)) <= n.data.size() * bits)
+                ++k;
+
+            // n = q * 10^L + r with q = (n >> L) / 5^L and r = ((n >> L) % 5^L) << L | n % 2^L
+            const size_t low = decimal_power_exponent(k);
+            num h;
+            num q = divmod(n >> low, five_power(k), h);
+            write_decimal(q, out, width ? width - low : 0);
+            write_decimal((h << low) | low_bits(n, low), out, low);
+            return;
+        }
+
+        small_vector<digit, 64> chunks;
+        digits t = n.data;
+        for (size_t len = t.size(); len;)
         {
-            r = a;
-            return a;
+            chunks.push_back(divrem_1(t.data(), t.data(), len, decimal_chunk));
+            while (len && !t[len - 1])
+                --len;
         }
 
-        num p = b;
-        num q = 0;
-        r = a;
+        const size_t chunk_width = chunks.size() * decimal_chunk_digits;
+        if (width > chunk_width)
+            write_zeros(out, width - chunk_width);
+        else if (!width && chunks.empty())
+            out("0", 1);
 
-        while (r > p || r == p)
+        for (size_t i = chunks.size(); i--;)
         {
-            const int d = 1u << std::max(0, bit_diff(r,p) - 1);
-            if (d > 1)
-                r -= p * d;
-            else 
-                r -= p;
-            q += d;
-        }
+            char buf[decimal_chunk_digits];
+            digit c = chunks[i];
+            for (size_t j = decimal_chunk_digits; j--; c /= 10)
+                buf[j] = char('0' + c % 10);
 
-        return q;
+            size_t skip = 0;
+            if (!width && i + 1 == chunks.size())
+                while (skip + 1 < decimal_chunk_digits && '0' == buf[skip])
+                    ++skip;
+            out(buf + skip, decimal_chunk_digits - skip);
+        }
     }
 
-
-    friend std::string as_decimal_string(num const& n)
+    template<class Out>
+    static void write_decimal(num const& n, Out& out)
     {
-        if(n.extension)
-			return "-" + as_decimal_string(-n);
-		if(n.data.empty())
-			return "0";
-
-		std::string res;
-		num r = n;
-        num d;
-        while (r > 0)
+        if (n.extension)
         {
-            r = divmod(r, 10, d);
-			res = char('0' + d.get(0)) + res;
-		}
-		return res;
+            out("-", 1);
+            write_decimal(-n, out, 0);
+        }
+        else
+            write_decimal(n, out, 0);
     }
 
-    friend std::ostream& operator << (std::ostream& os, num const& n)
-	{
-        return os << as_decimal_string(n);
+    template<class Out>
+    static void write_hex(num const& n, Out& out)
+    {
         if (n.extension)
         {
-            auto what = -n;
-            assert(!what.extension);
-			os << "-" << what;
-            return os;
+            out("-", 1);
+            return write_hex(-n, out);
         }
+        if (n.data.empty())
+            return out("0", 1);
 
-        bool w = false;
-        for (int i = n.data.size() - 1; i >= 0; --i)
+        bool leading = true;
+        for (size_t i = n.data.size(); i--;)
         {
-            if(!w && n.data[i] == 0)
-				continue;
-            if (bits < 4)
+            char buf[bits / 4];
+            size_t len = 0;
+            for (int j = bits - 4; j >= 0; j -= 4)
             {
-                for (int j = bits - 1; j >= 0; --j)
-                {
-                    w = true;
-                    os << "01"[n.data[i] >> j & 1];
-                }
+                const digit idx = (n.data[i] >> j) & 15;
+                if (leading && 0 == idx)
+                    continue;
+                leading = false;
+                buf[len++] = "0123456789ABCDEF"[idx];
             }
-            else
+            out(buf, len);
+        }
+    }
+
+    friend std::string as_decimal_string(num const& n)
+    {
+        std::string res;
+        auto out = [&res](char const* p, size_t len) { res.append(p, len); };
+        write_decimal(n, out);
+        return res;
+    }
+
+    friend std::string as_hex_string(num const& n)
+    {
+        std::string res;
+        auto out = [&res](char const* p, size_t len) { res.append(p, len); };
+        write_hex(n, out);
+        return res;
+    }
+
+    // decimal digits with an optional sign, no digits at all is 0
+    // any other character aborts, in release builds too
+    static num from_decimal_string(std::string_view s)
+    {
+        const bool negative = !s.empty() && '-' == s[0];
+        if (!s.empty() && ('-' == s[0] || '+' == s[0]))
+            s.remove_prefix(1);
+        if (s.empty())
+            return num();
+
+        // parse runs of chunks linearly, then merge neighbours pairwise with the cached powers
+        static constexpr size_t run_log = 3;
+        static constexpr size_t run = decimal_chunk_digits << run_log;
+
+        std::vector<num> parts;
+        parts.reserve(s.size() / run + 1);
+        for (size_t end = s.size(); end;)
+        {
+            const size_t begin = end > run ? end - run : 0;
+            num v;
+            size_t i = begin;
+            for (size_t len = (end - begin) % decimal_chunk_digits; i < end; len = decimal_chunk_digits)
             {
-                for (int j = bits - 4; j >= 0; j -= 4)
+                digit c = 0, scale = 1;
+                for (size_t j = 0; j < (len ? len : decimal_chunk_digits); ++j, ++i)
                 {
-                    u32 idx = (n.data[i] >> j) & 15;
-                    if (!w && idx == 0)
-                        continue;
-                    w = true;
-                    os << "0123456789ABCDEF"[idx];
+                    ER_ASSERT(s[i] >= '0' && s[i] <= '9');
+                    c = c * 10 + digit(s[i] - '0');
+                    scale *= 10;
                 }
+                v *= scale;
+                v += c;
+            }
+            parts.push_back(std::move(v));
+            end = begin;
+        }
+
+        for (size_t k = run_log; parts.size() > 1; ++k)
+        {
+            num const& p = five_power(k);
+            for (size_t i = 0; 2 * i < parts.size(); ++i)
+            {
+                num v = std::move(parts[2 * i]);
+                if (2 * i + 1 < parts.size())
+                    v += (parts[2 * i + 1] * p) << decimal_power_exponent(k);
+                parts[i] = std::move(v);
             }
+            parts.resize((parts.size() + 1) / 2);
         }
 
-        if(!w)
-            os << "0";
+        num res = std::move(parts[0]);
+        if (negative)
+            res.negate();
+        return res;
+    }
+
+    // hexadecimal digits with an optional sign and 0x prefix, no digits at all is 0
+    // any other character aborts, in release builds too
+    static num from_hex_string(std::string_view s)
+    {
+        const bool negative = !s.empty() && '-' == s[0];
+        if (!s.empty() && ('-' == s[0] || '+' == s[0]))
+            s.remove_prefix(1);
+        if (s.size() >= 2 && '0' == s[0] && ('x' == s[1] || 'X' == s[1]))
+            s.remove_prefix(2);
+        if (s.empty())
+            return num();
+
+        num res;
+        res.data.resize((s.size() * 4 + bits - 1) / bits);
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            const char c = s[s.size() - 1 - i];
+            digit v = 0;
+            if (c >= '0' && c <= '9') v = c - '0';
+            else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+            else ER_ASSERT(false && "invalid hex digit");
+            res.data[i * 4 / bits] |= v << (i * 4 % bits);
+        }
+        res.canonicalize();
+        if (negative)
+            res.negate();
+        return res;
+    }
+
+    // decimal unless the stream is in hex mode
+    friend std::ostream& operator << (std::ostream& os, num const& n)
+	{
+        auto out = [&os](char const* p, size_t len) { os.write(p, std::streamsize(len)); };
+        if (std::ios::hex == (os.flags() & std::ios::basefield))
+            write_hex(n, out);
+        else
+            write_decimal(n, out);
         return os;
 	}
 };
 
-}
\ No newline at end of file
+inline num num::reciprocal(num const& d)
+{
+    // approximate, the callers correct the few units of error
+    assert(!d.extension && !d.data.empty());
+    const size_t n = d.data.size();
+    const num one = shift_digits(1, 2 * n);
+    if (n < std::max<size_t>(newton_division_threshold, 8))
+    {
+        num x, r;
+        x.data.resize(n + 2);
+        r.data.resize(n);
+        if (1 == n)
+            r.data[0] = divrem_1(x.data.data(), one.data.data(), 2 * n + 1, d.data[0]);
+        else
+            divrem_knuth(x.data.data(), r.data.data(), one.data.data(), 2 * n + 1, d.data.data(), n);
+        x.canonicalize();
+        return x;
+    }
+
+    // the reciprocal of the top digits (plus two guard digits) is good to about half the digits,
+    // one newton step x += x * (B^2n - d * x) / B^2n doubles that
+    const size_t h = n / 2 + 2;
+    num x = shift_digits(reciprocal(from_digits(d.data.data() + n - h, h)), n - h);
+    const num e = one - d * x;
+
+    // only the top n - h + 3 digits of x and e reach the result
+    x += shift_digits(shift_digits(x, -ptrdiff_t(h - 2)) * shift_digits(e, -ptrdiff_t(n - 2)), -ptrdiff_t(n - h + 4));
+    return x;
+}
+
+inline void num::divrem_newton(digit* q, digit* rem, digit const* a, size_t an, digit const* b, size_t bn)
+{
+    const num d = from_digits(b, bn);
+    const num x = reciprocal(d);
+
+    // long division in blocks of bn digits, each block of at most 2bn digits is divided by multiplying with x
+    std::fill(q, q + an - bn + 1, digit(0));
+    num r;
+    size_t len = an % bn ? an % bn : bn;
+    for (size_t pos = an - len;; pos -= bn, len = bn)
+    {
+        num cur = shift_digits(r, len) + from_digits(a + pos, len);
+        num qb = shift_digits(shift_digits(cur, -ptrdiff_t(bn - 2)) * x, -ptrdiff_t(bn + 2));
+        if (qb.extension)
+            qb = 0;
+        r = cur - qb * d;
+        while (r.extension)
+        {
+            qb -= 1;
+            r += d;
+        }
+        while (r >= d)
+        {
+            qb += 1;
+            r -= d;
+        }
+        std::copy(qb.data.begin(), qb.data.end(), q + pos);
+        if (0 == pos)
+            break;
+    }
+    std::fill(rem, rem + bn, digit(0));
+    std::copy(r.data.begin(), r.data.end(), rem);
+}
+
+inline void num::mul_toom3(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+{
+    // evaluate at 0, 1, -1, -2 and infinity, interpolate with Bodrato's sequence
+    const size_t k = (an + 2) / 3;
+    auto part = [k](digit const* p, size_t n, size_t i)
+    {
+        const size_t lo = std::min(n, i * k);
+        const size_t hi = std::min(n, lo + k);
+        return from_digits(p + lo, hi - lo);
+    };
+
+    const num a0 = part(a, an, 0), a1 = part(a, an, 1), a2 = part(a, an, 2);
+    const num b0 = part(b, bn, 0), b1 = part(b, bn, 1), b2 = part(b, bn, 2);
+
+    num pa = a0 + a2, pb = b0 + b2;
+    const num pa1 = pa + a1, pb1 = pb + b1;
+    const num pam1 = pa - a1, pbm1 = pb - b1;
+    const num pam2 = ((pam1 + a2) << 1) - a0;
+    const num pbm2 = ((pbm1 + b2) << 1) - b0;
+
+    num r0 = a0 * b0;
+    num r1 = pa1 * pb1;
+    num rm1 = pam1 * pbm1;
+    num rm2 = pam2 * pbm2;
+    num r4 = a2 * b2;
+
+    num r3 = divexact_1(rm2 - r1, 3);
+    r1 = (r1 - rm1) >> 1;
+    num r2 = rm1 - r0;
+    r3 = ((r2 - r3) >> 1) + (r4 << 1);
+    r2 = r2 + r1 - r4;
+    r1 = r1 - r3;
+
+    std::fill(r, r + an + bn, digit(0));
+    num const* coeffs[] = { &r0, &r1, &r2, &r3, &r4 };
+    for (size_t i = 0; i < 5; ++i)
+    {
+        num const& c = *coeffs[i];
+        assert(!c.extension);
+        if (c.data.empty())
+            continue;
+        assert(i * k + c.data.size() <= an + bn);
+        add(r + i * k, r + i * k, an + bn - i * k, c.data.data(), c.data.size());
+    }
+}
+
+inline bool num::mul_ntt(digit* r, digit const* a, size_t an, digit const* b, size_t bn)
+{
+    // 32 bit pieces while the coefficients fit the three primes, 16 bit pieces after that
+    constexpr size_t per_digit = bits / 32;
+    int piece_bits = 32;
+    if (!ntt::fits((an + bn) * per_digit, 32))
+        piece_bits = 16;
+    const size_t pieces_per_digit = bits / size_t(piece_bits);
+    if (!ntt::fits((an + bn) * pieces_per_digit, piece_bits))
+        return false;
+
+    const u32 piece_mask = piece_bits < 32 ? (u32(1) << piece_bits) - 1 : ~u32(0);
+    auto split = [&](digit const* p, size_t n)
+    {
+        std::vector<u32> res(n * pieces_per_digit);
+        for (size_t i = 0; i < res.size(); ++i)
+            res[i] = u32(p[i / pieces_per_digit] >> (i % pieces_per_digit * piece_bits)) & piece_mask;
+        return res;
+    };
+
+    const bool square = a == b && an == bn;
+    const std::vector<u32> pa = split(a, an);
+    const std::vector<u32> pb = square ? std::vector<u32>() : split(b, bn);
+    std::vector<u32> pr((an + bn) * pieces_per_digit);
+    ntt::multiply(pr.data(), pa.data(), pa.size(), square ? nullptr : pb.data(), pb.size(), piece_bits);
+
+    for (size_t i = 0; i < an + bn; ++i)
+    {
+        digit d = 0;
+        for (size_t j = 0; j < pieces_per_digit; ++j)
+            d |= digit(pr[i * pieces_per_digit + j]) << (j * piece_bits);
+        r[i] = d;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <num.hpp>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace er
+{
+
+namespace detail
+{
+
+// 32 bit limbs widened to 64 bit lanes, so a carry or a 32 x 32 bit product plus two limbs fits in a lane
+struct scalar_lanes
+{
+    using reg = u64;
+    ER_STATIC_CONSTEXPR size_t width = 1;
+
+    static reg load(u32 const* p) { return *p; }
+    static void store(u32* p, reg v) { *p = u32(v); }
+    static reg set1(u64 v) { return v; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg sub(reg a, reg b) { return a - b; }
+    static reg mul(reg a, reg b) { return (a & 0xffffffff) * (b & 0xffffffff); }
+    static reg shr31(reg a) { return a >> 31; }
+    static reg shr32(reg a) { return a >> 32; }
+    static reg bit_and(reg a, reg b) { return a & b; }
+    static reg bit_or(reg a, reg b) { return a | b; }
+    static reg bit_xor(reg a, reg b) { return a ^ b; }
+};
+
+#if defined(__AVX2__)
+struct avx2_lanes
+{
+    using reg = __m256i;
+    ER_STATIC_CONSTEXPR size_t width = 4;
+
+    static reg load(u32 const* p) { return _mm256_cvtepu32_epi64(_mm_loadu_si128((__m128i const*)p)); }
+    static void store(u32* p, reg v)
+    {
+        const reg packed = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(packed));
+    }
+    static reg set1(u64 v) { return _mm256_set1_epi64x(i64(v)); }
+    static reg add(reg a, reg b) { return _mm256_add_epi64(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_epi64(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_epu32(a, b); }
+    static reg shr31(reg a) { return _mm256_srli_epi64(a, 31); }
+    static reg shr32(reg a) { return _mm256_srli_epi64(a, 32); }
+    static reg bit_and(reg a, reg b) { return _mm256_and_si256(a, b); }
+    static reg bit_or(reg a, reg b) { return _mm256_or_si256(a, b); }
+    static reg bit_xor(reg a, reg b) { return _mm256_xor_si256(a, b); }
+};
+#endif
+
+#if defined(__AVX512F__)
+struct avx512_lanes
+{
+    using reg = __m512i;
+    ER_STATIC_CONSTEXPR size_t width = 8;
+
+    static reg load(u32 const* p) { return _mm512_cvtepu32_epi64(_mm256_loadu_si256((__m256i const*)p)); }
+    static void store(u32* p, reg v) { _mm256_storeu_si256((__m256i*)p, _mm512_cvtepi64_epi32(v)); }
+    static reg set1(u64 v) { return _mm512_set1_epi64(i64(v)); }
+    static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+    static reg sub(reg a, reg b) { return _mm512_sub_epi64(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_epu32(a, b); }
+    static reg shr31(reg a) { return _mm512_srli_epi64(a, 31); }
+    static reg shr32(reg a) { return _mm512_srli_epi64(a, 32); }
+    static reg bit_and(reg a, reg b) { return _mm512_and_si512(a, b); }
+    static reg bit_or(reg a, reg b) { return _mm512_or_si512(a, b); }
+    static reg bit_xor(reg a, reg b) { return _mm512_xor_si512(a, b); }
+};
+#endif
+
+// widest lanes the target was compiled for, e.g. -mavx2 or -march=native
+#if defined(__AVX512F__)
+using batch_lanes = avx512_lanes;
+#elif defined(__AVX2__)
+using batch_lanes = avx2_lanes;
+#else
+using batch_lanes = scalar_lanes;
+#endif
+
+}
+
+// count numbers of the same number of 32 bit limbs in two's complement, stored limb major:
+// limb i of number j is data[i * count + j], so one limb of consecutive numbers fills a vector register
+// arithmetic wraps at the limb count like wide_int, mul widens to the sum of both limb counts
+struct num_batch
+{
+    size_t count = 0;
+    size_t limbs = 0;
+    std::vector<u32> data;
+
+    num_batch() = default;
+
+    num_batch(size_t count, size_t limbs) : count(count), limbs(limbs), data(count * limbs) {}
+
+    // values reduced modulo 2^(32 * limbs)
+    num_batch(std::vector<num> const& values, size_t limbs) : num_batch(values.size(), limbs)
+    {
+        for (size_t j = 0; j < count; ++j)
+            set(j, values[j]);
+    }
+
+    u32* limb(size_t i) { return data.data() + i * count; }
+    u32 const* limb(size_t i) const { return data.data() + i * count; }
+
+    void set(size_t j, num const& v)
+    {
+        for (size_t i = 0; i < limbs; ++i)
+            limb(i)[j] = u32(v.get(i * 32 / num::bits) >> (i * 32 % num::bits));
+    }
+
+    num get(size_t j) const
+    {
+        num res;
+        res.extension = limbs && (limb(limbs - 1)[j] >> 31) ? num::mask : 0;
+        res.data.resize((limbs * 32 + num::bits - 1) / num::bits);
+        for (size_t i = 0; i < limbs; ++i)
+            res.data[i * 32 / num::bits] |= digit(limb(i)[j]) << (i * 32 % num::bits);
+        if (32 * limbs % num::bits)
+            res.data.back() |= res.extension << (32 * limbs % num::bits);
+        res.canonicalize();
+        return res;
+    }
+
+    std::vector<num> unpack() const
+    {
+        std::vector<num> res;
+        res.reserve(count);
+        for (size_t j = 0; j < count; ++j)
+            res.push_back(get(j));
+        return res;
+    }
+
+    // r = a + b, r may be a or b
+    friend void add(num_batch& r, num_batch const& a, num_batch const& b)
+    {
+        add_sub(r, a, b, false);
+    }
+
+    // r = a - b, r may be a or b
+    friend void sub(num_batch& r, num_batch const& a, num_batch const& b)
+    {
+        add_sub(r, a, b, true);
+    }
+
+    // r = a * b with a.limbs + b.limbs limbs, r must not be a or b
+    friend void mul(num_batch& r, num_batch const& a, num_batch const& b)
+    {
+        assert(a.count == b.count && &r != &a && &r != &b);
+        r.resize(a.count, a.limbs + b.limbs);
+        for_lanes(a.count, [&]<class V>(size_t j)
+        {
+            mul_lanes<V>(r, a, b, j);
+        });
+    }
+
+    // sign of a - b for every number
+    friend void compare(i8* res, num_batch const& a, num_batch const& b)
+    {
+        assert(a.count == b.count && a.limbs == b.limbs && a.limbs);
+        for_lanes(a.count, [&]<class V>(size_t j)
+        {
+            compare_lanes<V>(res, a, b, j);
+        });
+    }
+
+    friend num_batch operator +(num_batch const& a, num_batch const& b) { num_batch r; add(r, a, b); return r; }
+    friend num_batch operator -(num_batch const& a, num_batch const& b) { num_batch r; sub(r, a, b); return r; }
+    friend num_batch operator *(num_batch const& a, num_batch const& b) { num_batch r; mul(r, a, b); return r; }
+
+    friend std::vector<i8> compare(num_batch const& a, num_batch const& b)
+    {
+        std::vector<i8> res(a.count);
+        compare(res.data(), a, b);
+        return res;
+    }
+
+private:
+    void resize(size_t n, size_t l)
+    {
+        count = n;
+        limbs = l;
+        data.resize(n * l);
+    }
+
+    // f<V>(j) on full vectors of lanes, the tail one lane at a time
+    template<class F>
+    static void for_lanes(size_t count, F&& f)
+    {
+        using V = detail::batch_lanes;
+        size_t j = 0;
+        for (; j + V::width <= count; j += V::width)
+            f.template operator()<V>(j);
+        for (; j < count; ++j)
+            f.template operator()<detail::scalar_lanes>(j);
+    }
+
+    // subtraction is a + ~b + 1
+    static void add_sub(num_batch& r, num_batch const& a, num_batch const& b, bool subtract)
+    {
+        assert(a.count == b.count && a.limbs == b.limbs);
+        if (&r != &a && &r != &b)
+            r.resize(a.count, a.limbs);
+        const size_t count = a.count, n = a.limbs;
+        u32* pr = r.data.data();
+        u32 const* pa = a.data.data();
+        u32 const* pb = b.data.data();
+        for_lanes(count, [&]<class V>(size_t j)
+        {
+            const auto flip = V::set1(subtract ? 0xffffffff : 0);
+            auto carry = V::set1(subtract ? 1 : 0);
+            for (size_t i = 0; i < n; ++i)
+            {
+                const auto s = V::add(V::add(V::load(pa + i * count + j), V::bit_xor(V::load(pb + i * count + j), flip)), carry);
+                V::store(pr + i * count + j, s);
+                carry = V::shr32(s);
+            }
+        });
+    }
+
+    // all ones in the low 32 bits of lanes whose number is negative
+    template<class V>
+    static auto sign_mask(num_batch const& x, size_t j)
+    {
+        const auto top = V::load(x.limb(x.limbs - 1) + j);
+        return V::bit_and(V::sub(V::set1(0), V::shr31(top)), V::set1(0xffffffff));
+    }
+
+    // r[off..off+x.limbs) -= x & m on lanes j
+    template<class V>
+    static void sub_masked(num_batch& r, size_t off, num_batch const& x, typename V::reg m, size_t j)
+    {
+        const auto ones = V::set1(0xffffffff);
+        auto carry = V::set1(1);
+        for (size_t i = 0; i < x.limbs; ++i)
+        {
+            u32* p = r.limb(off + i) + j;
+            const auto s = V::add(V::add(V::load(p), V::bit_xor(V::bit_and(V::load(x.limb(i) + j), m), ones)), carry);
+            V::store(p, s);
+            carry = V::shr32(s);
+        }
+    }
+
+    // product scanning on the unsigned values, then a * b = A * B - [a < 0] B 2^(32 la) - [b < 0] A 2^(32 lb)
+    // the halves of the column products are summed apart, so a column of up to 2^31 products cannot overflow a lane
+    template<class V>
+    static void mul_lanes(num_batch& r, num_batch const& a, num_batch const& b, size_t j)
+    {
+        const auto low = V::set1(0xffffffff);
+        auto carry = V::set1(0);
+        for (size_t k = 0; k < r.limbs; ++k)
+        {
+            auto lo = carry, hi = V::set1(0);
+            const size_t first = k < b.limbs ? 0 : k - b.limbs + 1;
+            const size_t last = std::min(k + 1, a.limbs);
+            for (size_t i = first; i < last; ++i)
+            {
+                const auto p = V::mul(V::load(a.limb(i) + j), V::load(b.limb(k - i) + j));
+                lo = V::add(lo, V::bit_and(p, low));
+                hi = V::add(hi, V::shr32(p));
+            }
+            V::store(r.limb(k) + j, lo);
+            carry = V::add(V::shr32(lo), hi);
+        }
+
+        if (a.limbs && b.limbs)
+        {
+            sub_masked<V>(r, a.limbs, b, sign_mask<V>(a, j), j);
+            sub_masked<V>(r, b.limbs, a, sign_mask<V>(b, j), j);
+        }
+    }
+
+    // a - b one limb wider than the operands, its top limb holds the sign and any limb being non zero means a != b
+    template<class V>
+    static void compare_lanes(i8* res, num_batch const& a, num_batch const& b, size_t j)
+    {
+        const auto ones = V::set1(0xffffffff);
+        auto carry = V::set1(1);
+        auto nonzero = V::set1(0);
+        for (size_t i = 0; i < a.limbs; ++i)
+        {
+            const auto s = V::add(V::add(V::load(a.limb(i) + j), V::bit_xor(V::load(b.limb(i) + j), ones)), carry);
+            nonzero = V::bit_or(nonzero, V::bit_and(s, ones));
+            carry = V::shr32(s);
+        }
+        const auto top = V::add(V::add(sign_mask<V>(a, j), V::bit_xor(sign_mask<V>(b, j), ones)), carry);
+        nonzero = V::bit_or(nonzero, V::bit_and(top, ones));
+
+        // a negative difference is never zero, so the order is [a != b] - 2 [a < b]
+        const auto sign = V::shr31(V::bit_and(top, ones));
+        const auto order = V::sub(V::shr32(V::add(nonzero, ones)), V::add(sign, sign));
+        u32 o[V::width];
+        V::store(o, order);
+        for (size_t k = 0; k < V::width; ++k)
+            res[j + k] = i8(o[k]);
+    }
+};
+
+}
@@ -12,20 +12,28 @@ struct polynomial
 {
     row_vec<T, 1 + N> data = {};
 
-    polynomial() = default;
+    constexpr polynomial() = default;
 
     template<class...Args> requires(sizeof...(Args) == (1 + N) && (std::is_convertible_v<Args, T> && ...))
-    polynomial(Args&&...args) : data{ T(std::forward<Args>(args))... } {}
+    constexpr polynomial(Args&&...args) : data{ T(std::forward<Args>(args))... } {}
     
-    friend polynomial operator-(polynomial const& p) { return polynomial(-p.data); }
+    friend constexpr polynomial operator-(polynomial const& p) { return polynomial(-p.data); }
 
     template<int M>
-    friend polynomial<T, max_v<N,M>> operator- (polynomial const& a, polynomial<T, M> const& b) { return a + -b; }
+    friend constexpr polynomial<T, max_v<N,M>> operator- (polynomial const& a, polynomial<T, M> const& b) { return a + -b; }
     template<int M>
-    friend polynomial<T, max_v<N,M>> operator+ (polynomial const& a, polynomial<T, M> const& b){ return polynomial<T, max_v<N,M>>(right_fill<max_v<N,M> - N>(a.data) + right_fill<max_v<N,M> - M>(b.data)); }
+    friend constexpr polynomial<T, max_v<N,M>> operator+ (polynomial const& a, polynomial<T, M> const& b)
+    {
+        polynomial<T, max_v<N,M>> result;
+        for (int i = 0; i <= N; i++)
+            result.data[i] += a.data[i];
+        for (int i = 0; i <= M; i++)
+            result.data[i] += b.data[i];
+        return result;
+    }
     
     template<int M>
-    friend polynomial<T, N + M> operator* (polynomial const& a, polynomial<T, M> const& b)
+    friend constexpr polynomial<T, N + M> operator* (polynomial const& a, polynomial<T, M> const& b)
     {
         polynomial<T, N + M> result;
         for (int i = 0; i <= N; i++)
@@ -34,15 +42,15 @@ struct polynomial
         return result;
     }
 
-    friend polynomial<T, N - 1> derivative(polynomial const& p)
+    friend constexpr polynomial<T, N - 1> derivative(polynomial const& p)
     {
         row_vec<T, N> result;
         for (int i = 0; i < N; i++)
-            result.data[i] = p.data[i + 1] * (i + 1);
+            result[i] = p.data[i + 1] * T(i + 1);
         return result;
     }
 
-    T operator()(T const& x) const
+    constexpr T operator()(T const& x) const
     {
         T result = 0;
         for (int i = N; i >= 0; --i)
@@ -287,7 +295,7 @@ struct polynomial
         return os;
     }
 
-    polynomial(row_vec<T, 1 + N> const& data) : data(data) {}
+    constexpr polynomial(row_vec<T, 1 + N> const& data) : data(data) {}
 };
 
 
@@ -1,27 +1,502 @@
+#pragma once
+
 #include <num.hpp>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <numeric>
 
 namespace er
 {
+
+// exact fraction nom / denom with denom > 0
+// results are not reduced after every operation, the gcd runs once the denominator has grown past
+// max(reduce_bits, 2 * its size after the last reduction) or when reduce() is called
 struct rational
 {
-    num  nom, denom;
+    num  nom, denom = 1;
+
+    // bit length of denom right after the last reduction
+    size_t reduced_bits = 0;
+
+    // denominators below this many bits are never reduced implicitly
+    static inline size_t reduce_bits = 512;
 
     rational() = default;
 
-    rational(f32 f)
+    template<class T> requires(std::is_integral_v<T>)
+    rational(T n) : nom(n) {}
+
+    rational(num n, num d = 1) : nom(std::move(n)), denom(std::move(d))
+    {
+        assert(0 != denom);
+        if (denom < 0)
+        {
+            nom.negate();
+            denom.negate();
+        }
+    }
+
+    // exact, every finite double is a dyadic fraction
+    rational(f64 f)
     {
-        ER_CONSTEXPR u32 mantissa_mask = (1<<23)-1;
+        assert(std::isfinite(f));
         int exp = 0;
-        f = std::frexp(f, &exp);
-        u32 digits = ((u32&)f & mantissa_mask) | (1 << 23);
-        nom = num(digits);
-        denom = (1<<-(exp-24));
+        const f64 m = std::frexp(f, &exp);
+        constexpr int digits = std::numeric_limits<f64>::digits;
+        nom = num(i64(std::ldexp(m, digits)));
+        exp -= digits;
+        if (0 == nom)
+            return;
+
+        // the denominator is a power of two, so cancelling trailing zeros fully reduces
+        const size_t tz = countr_zero(nom);
+        nom >>= tz;
+        exp += int(tz);
+        if (exp >= 0)
+            nom <<= size_t(exp);
+        else
+            denom = num(1) << size_t(-exp);
+        reduced_bits = bit_length(denom);
+    }
+
+    rational(f32 f) : rational(f64(f)) {}
+
+    bool is_reduced() const
+    {
+        return gcd(nom, denom) == 1;
+    }
+
+    // divides out the gcd of nom and denom
+    rational& reduce()
+    {
+        if (0 == nom)
+            denom = 1;
+        else
+        {
+            const num g = gcd(nom, denom);
+            if (g != 1)
+            {
+                nom = nom / g;
+                denom = denom / g;
+            }
+        }
+        reduced_bits = bit_length(denom);
+        return *this;
+    }
+
+    friend rational reduced(rational r)
+    {
+        return std::move(r.reduce());
+    }
+
+    friend rational operator -(rational const& r)
+    {
+        rational res = r;
+        res.nom.negate();
+        return res;
+    }
+
+    friend rational operator +(rational const& l, rational const& r)
+    {
+        return combine(l, r, false);
+    }
+
+    friend rational operator -(rational const& l, rational const& r)
+    {
+        return combine(l, r, true);
+    }
+
+    friend rational operator *(rational const& l, rational const& r)
+    {
+        rational res;
+        res.nom = l.nom * r.nom;
+        res.denom = l.denom * r.denom;
+        res.reduced_bits = std::max(l.reduced_bits, r.reduced_bits);
+        res.lazy_reduce();
+        return res;
+    }
+
+    friend rational operator /(rational const& l, rational const& r)
+    {
+        assert(0 != r.nom);
+        rational res;
+        res.nom = l.nom * r.denom;
+        res.denom = l.denom * r.nom;
+        if (res.denom < 0)
+        {
+            res.nom.negate();
+            res.denom.negate();
+        }
+        res.reduced_bits = std::max(l.reduced_bits, r.reduced_bits);
+        res.lazy_reduce();
+        return res;
+    }
+
+    friend rational& operator +=(rational& l, rational const& r) { return l = l + r; }
+    friend rational& operator -=(rational& l, rational const& r) { return l = l - r; }
+    friend rational& operator *=(rational& l, rational const& r) { return l = l * r; }
+    friend rational& operator /=(rational& l, rational const& r) { return l = l / r; }
+
+    // cross multiplication, so neither side needs to be reduced
+    friend bool operator ==(rational const& l, rational const& r)
+    {
+        if (l.denom == r.denom)
+            return l.nom == r.nom;
+        return l.nom * r.denom == r.nom * l.denom;
+    }
+
+    friend std::strong_ordering operator <=>(rational const& l, rational const& r)
+    {
+        if (l.denom == r.denom)
+            return l.nom <=> r.nom;
+        return l.nom * r.denom <=> r.nom * l.denom;
+    }
+
+    // nearest f32 or f64, ties to even
+    template<class F>
+    F to_floating() const
+    {
+        using limits = std::numeric_limits<F>;
+        if (0 == nom)
+            return F(0);
+        num n = nom;
+        n.abs();
+
+        // q = floor(n * 2^s / denom) has digits + 2 or digits + 3 bits
+        const ptrdiff_t e = ptrdiff_t(bit_length(n)) - ptrdiff_t(bit_length(denom));
+        const ptrdiff_t s = limits::digits + 2 - e;
+        num rem;
+        const num q = s >= 0 ? divmod(n << size_t(s), denom, rem) : divmod(n, denom << size_t(-s), rem);
+
+        // lowest kept bit, the subnormal range has fewer mantissa bits
+        const ptrdiff_t top = ptrdiff_t(bit_length(q)) - s;
+        const ptrdiff_t low = std::max<ptrdiff_t>(top - limits::digits, limits::min_exponent - limits::digits);
+        const size_t drop = size_t(low + s);
+
+        num m = q >> drop;
+        const bool half = 0 != ((q >> (drop - 1)) & 1);
+        const bool sticky = 0 != rem || 0 != num::low_bits(q, drop - 1);
+        if (half && (sticky || 0 != (m & 1)))
+            m += 1;
+
+        u64 mantissa = 0;
+        for (size_t i = 0; i * num::bits < 64; ++i)
+            mantissa |= u64(m.get(i)) << (i * num::bits);
+        const F res = std::ldexp(F(mantissa), int(low));
+        return nom < 0 ? -res : res;
     }
-    
+
+    explicit operator f64() const { return to_floating<f64>(); }
+    explicit operator f32() const { return to_floating<f32>(); }
+
     friend std::ostream& operator << (std::ostream& os, rational const& r)
     {
-        return os << r.nom << " / " << r.denom;
+        const rational c = reduced(r);
+        return os << c.nom << " / " << c.denom;
+    }
+
+private:
+    static rational combine(rational const& l, rational const& r, bool subtract)
+    {
+        rational res;
+        if (l.denom == r.denom)
+        {
+            res.nom = subtract ? l.nom - r.nom : l.nom + r.nom;
+            res.denom = l.denom;
+        }
+        else
+        {
+            const num a = l.nom * r.denom, b = r.nom * l.denom;
+            res.nom = subtract ? a - b : a + b;
+            res.denom = l.denom * r.denom;
+        }
+        res.reduced_bits = std::max(l.reduced_bits, r.reduced_bits);
+        res.lazy_reduce();
+        return res;
+    }
+
+    void lazy_reduce()
+    {
+        if (bit_length(denom) > std::max(reduce_bits, 2 * reduced_bits))
+            reduce();
+    }
+};
+
+namespace detail
+{
+
+// r = a op b, false on overflow, INT64_MIN counts as overflow so negation stays safe
+inline bool checked_add(i64 a, i64 b, i64& r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return !__builtin_add_overflow(a, b, &r) && INT64_MIN != r;
+#else
+    if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a <= INT64_MIN - b))
+        return false;
+    r = a + b;
+    return true;
+#endif
+}
+
+inline bool checked_mul(i64 a, i64 b, i64& r)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return !__builtin_mul_overflow(a, b, &r) && INT64_MIN != r;
+#elif defined(_M_X64)
+    i64 hi = 0;
+    r = _mul128(a, b, &hi);
+    return hi == (r >> 63) && INT64_MIN != r;
+#else
+    if (a && (b > INT64_MAX / (a < 0 ? -a : a) || b < -(INT64_MAX / (a < 0 ? -a : a))))
+        return false;
+    r = a * b;
+    return true;
+#endif
+}
+
+inline i64 gcd_i64(i64 a, i64 b)
+{
+    const u64 ua = u64(a < 0 ? -a : a), ub = u64(b < 0 ? -b : b);
+    if (1 == ua || 1 == ub)
+        return 1;
+    return i64(std::gcd(ua, ub));
+}
+
+}
+
+// rational that keeps a reduced i64 pair inline and moves to a heap allocated rational
+// only when a result does not fit, results that fit again move back
+struct small_rational
+{
+    i64 n = 0, d = 1;
+    std::unique_ptr<rational> big;
+
+    small_rational() = default;
+
+    template<class T> requires(std::is_integral_v<T>)
+    small_rational(T v)
+    {
+        if constexpr (sizeof(T) <= sizeof(i64))
+        {
+            if (std::is_signed_v<T> ? INT64_MIN != i64(v) : u64(v) <= u64(INT64_MAX))
+            {
+                n = i64(v);
+                return;
+            }
+        }
+        assign(rational(v));
+    }
+
+    // num / den, den != 0
+    small_rational(i64 num_, i64 den)
+    {
+        assert(den);
+        if (INT64_MIN == num_ || INT64_MIN == den)
+        {
+            assign(rational(num(num_), num(den)));
+            return;
+        }
+        set_reduced(num_, den);
+    }
+
+    small_rational(rational const& r) { assign(r); }
+
+    small_rational(small_rational const& o) : n(o.n), d(o.d), big(o.big ? std::make_unique<rational>(*o.big) : nullptr) {}
+    small_rational(small_rational&&) noexcept = default;
+
+    small_rational& operator=(small_rational const& o)
+    {
+        if (this != &o)
+        {
+            n = o.n;
+            d = o.d;
+            big = o.big ? std::make_unique<rational>(*o.big) : nullptr;
+        }
+        return *this;
+    }
+
+    small_rational& operator=(small_rational&&) noexcept = default;
+
+    bool is_small() const { return !big; }
+
+    rational to_rational() const
+    {
+        return big ? *big : rational(num(n), num(d));
+    }
+
+    friend small_rational operator -(small_rational const& r)
+    {
+        if (r.big)
+            return small_rational(-*r.big);
+        small_rational res;
+        res.n = -r.n;
+        res.d = r.d;
+        return res;
+    }
+
+    // Knuth, TAOCP vol. 2, 4.5.1, the gcd of the denominators keeps intermediates small
+    friend small_rational operator +(small_rational const& l, small_rational const& r)
+    {
+        if (!l.big && !r.big)
+        {
+            small_rational res;
+            if (l.d == r.d)
+            {
+                i64 t;
+                if (detail::checked_add(l.n, r.n, t))
+                {
+                    res.set_reduced(t, l.d);
+                    return res;
+                }
+            }
+            else
+            {
+                const i64 g = detail::gcd_i64(l.d, r.d);
+                i64 a, b, t, den;
+                if (detail::checked_mul(l.n, r.d / g, a) && detail::checked_mul(r.n, l.d / g, b) && detail::checked_add(a, b, t))
+                {
+                    const i64 g2 = 1 == g ? 1 : detail::gcd_i64(t, g);
+                    if (detail::checked_mul(l.d / g, r.d / g2, den))
+                    {
+                        res.n = t / g2;
+                        res.d = den;
+                        if (0 == res.n)
+                            res.d = 1;
+                        return res;
+                    }
+                }
+            }
+        }
+        return small_rational(l.to_rational() + r.to_rational());
+    }
+
+    friend small_rational operator -(small_rational const& l, small_rational const& r)
+    {
+        return l + -r;
+    }
+
+    friend small_rational operator *(small_rational const& l, small_rational const& r)
+    {
+        if (!l.big && !r.big)
+        {
+            // cross cancelling keeps the result reduced
+            small_rational res;
+            if (0 == l.n || 0 == r.n)
+                return res;
+            const i64 g1 = detail::gcd_i64(l.n, r.d), g2 = detail::gcd_i64(r.n, l.d);
+            if (detail::checked_mul(l.n / g1, r.n / g2, res.n) && detail::checked_mul(l.d / g2, r.d / g1, res.d))
+                return res;
+        }
+        return small_rational(l.to_rational() * r.to_rational());
+    }
+
+    friend small_rational operator /(small_rational const& l, small_rational const& r)
+    {
+        if (!r.big)
+        {
+            assert(r.n);
+            small_rational inv;
+            inv.n = r.n < 0 ? -r.d : r.d;
+            inv.d = r.n < 0 ? -r.n : r.n;
+            return l * inv;
+        }
+        return small_rational(l.to_rational() / r.to_rational());
+    }
+
+    friend small_rational& operator +=(small_rational& l, small_rational const& r) { return l = l + r; }
+    friend small_rational& operator -=(small_rational& l, small_rational const& r) { return l = l - r; }
+    friend small_rational& operator *=(small_rational& l, small_rational const& r) { return l = l * r; }
+    friend small_rational& operator /=(small_rational& l, small_rational const& r) { return l = l / r; }
+
+    // both sides are reduced, so the small forms compare field by field
+    friend bool operator ==(small_rational const& l, small_rational const& r)
+    {
+        if (!l.big && !r.big)
+            return l.n == r.n && l.d == r.d;
+        return l.to_rational() == r.to_rational();
+    }
+
+    friend std::strong_ordering operator <=>(small_rational const& l, small_rational const& r)
+    {
+        if (!l.big && !r.big)
+        {
+            if (l.d == r.d)
+                return l.n <=> r.n;
+            i64 a, b;
+            if (detail::checked_mul(l.n, r.d, a) && detail::checked_mul(r.n, l.d, b))
+                return a <=> b;
+        }
+        return l.to_rational() <=> r.to_rational();
+    }
+
+    explicit operator f64() const
+    {
+        // both exact in a double, so the hardware division rounds correctly
+        constexpr i64 exact = i64(1) << std::numeric_limits<f64>::digits;
+        if (!big && n > -exact && n < exact && d < exact)
+            return f64(n) / f64(d);
+        return f64(to_rational());
+    }
+
+    explicit operator f32() const
+    {
+        constexpr i64 exact = i64(1) << std::numeric_limits<f32>::digits;
+        if (!big && n > -exact && n < exact && d < exact)
+            return f32(n) / f32(d);
+        return f32(to_rational());
+    }
+
+    friend std::ostream& operator << (std::ostream& os, small_rational const& r)
+    {
+        if (r.big)
+            return os << *r.big;
+        return os << r.n << " / " << r.d;
+    }
+
+private:
+    void set_reduced(i64 a, i64 b)
+    {
+        const i64 g = detail::gcd_i64(a, b);
+        n = b < 0 ? -a / g : a / g;
+        d = b < 0 ? -b / g : b / g;
+        if (0 == n)
+            d = 1;
+    }
+
+    // moves back inline if the reduced value fits
+    void assign(rational r)
+    {
+        if (fits(r.nom) && fits(r.denom))
+        {
+            big.reset();
+            set_reduced(to_i64(r.nom), to_i64(r.denom));
+            return;
+        }
+        r.reduce();
+        if (fits(r.nom) && fits(r.denom))
+        {
+            big.reset();
+            n = to_i64(r.nom);
+            d = to_i64(r.denom);
+            return;
+        }
+        big = std::make_unique<rational>(std::move(r));
+    }
+
+    // in i64 and not INT64_MIN
+    static bool fits(num const& v)
+    {
+        return bit_length(v) < 64 && v != INT64_MIN;
+    }
+
+    static i64 to_i64(num const& v)
+    {
+        u64 res = 0;
+        for (size_t i = 0; i * num::bits < 64; ++i)
+            res |= u64(v.get(i)) << (i * num::bits);
+        return i64(res);
     }
 };
 
-};
\ No newline at end of file
+}
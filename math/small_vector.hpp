@@ -0,0 +1,144 @@
+#pragma once
+
+#include <defines.hpp>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace er
+{
+
+// heap allocations made by small_vector on the calling thread
+inline thread_local size_t small_vector_allocations = 0;
+
+// contiguous storage for trivially copyable values
+// the first N elements live inline, the heap is only touched past that
+template<class T, size_t N>
+struct small_vector
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    constexpr small_vector() = default;
+
+    constexpr explicit small_vector(size_t n, T const& v = T()) { resize(n, v); }
+
+    template<std::input_iterator It>
+    constexpr small_vector(It first, It last) { assign(first, last); }
+
+    constexpr small_vector(small_vector const& o) { assign(o.begin(), o.end()); }
+    constexpr small_vector(small_vector&& o) noexcept { steal(o); }
+
+    constexpr ~small_vector() { delete[] heap; }
+
+    constexpr small_vector& operator=(small_vector const& o)
+    {
+        if (this != &o)
+            assign(o.begin(), o.end());
+        return *this;
+    }
+
+    constexpr small_vector& operator=(small_vector&& o) noexcept
+    {
+        if (this != &o)
+        {
+            delete[] heap;
+            heap = nullptr;
+            cap = N;
+            steal(o);
+        }
+        return *this;
+    }
+
+    constexpr T* data() { return heap ? heap : buffer; }
+    constexpr T const* data() const { return heap ? heap : buffer; }
+
+    constexpr size_t size() const { return sz; }
+    constexpr size_t capacity() const { return cap; }
+    constexpr bool empty() const { return 0 == sz; }
+    constexpr bool is_inline() const { return !heap; }
+
+    constexpr T* begin() { return data(); }
+    constexpr T* end() { return data() + sz; }
+    constexpr T const* begin() const { return data(); }
+    constexpr T const* end() const { return data() + sz; }
+
+    constexpr T& operator[](size_t i) { assert(i < sz); return data()[i]; }
+    constexpr T const& operator[](size_t i) const { assert(i < sz); return data()[i]; }
+
+    constexpr T& back() { assert(sz); return data()[sz - 1]; }
+    constexpr T const& back() const { assert(sz); return data()[sz - 1]; }
+
+    constexpr void reserve(size_t n)
+    {
+        if (n <= cap)
+            return;
+        n = std::max(n, 2 * cap);
+        T* p = new T[n];
+        if (!std::is_constant_evaluated())
+            ++small_vector_allocations;
+        std::copy(begin(), end(), p);
+        delete[] heap;
+        heap = p;
+        cap = n;
+    }
+
+    constexpr void resize(size_t n, T const& v = T())
+    {
+        reserve(n);
+        if (n > sz)
+            std::fill(data() + sz, data() + n, v);
+        sz = n;
+    }
+
+    template<std::input_iterator It>
+    constexpr void assign(It first, It last)
+    {
+        const size_t n = size_t(std::distance(first, last));
+        if (n > cap)
+        {
+            sz = 0;
+            reserve(n);
+        }
+        std::copy(first, last, data());
+        sz = n;
+    }
+
+    constexpr void push_back(T const& v)
+    {
+        const T t = v;
+        if (sz == cap)
+            reserve(sz + 1);
+        data()[sz++] = t;
+    }
+
+    constexpr void pop_back() { assert(sz); --sz; }
+    constexpr void clear() { sz = 0; }
+
+    friend constexpr bool operator==(small_vector const& l, small_vector const& r)
+    {
+        return std::equal(l.begin(), l.end(), r.begin(), r.end());
+    }
+
+private:
+    constexpr void steal(small_vector& o)
+    {
+        if (o.heap)
+        {
+            heap = o.heap;
+            cap = o.cap;
+            o.heap = nullptr;
+            o.cap = N;
+        }
+        else
+            std::copy(o.begin(), o.end(), buffer);
+        sz = o.sz;
+        o.sz = 0;
+    }
+
+    T* heap = nullptr;
+    size_t sz = 0;
+    size_t cap = N;
+    T buffer[N] = {};
+};
+
+}
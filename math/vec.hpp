@@ -1,7 +1,10 @@
 #pragma once
 
 #include <defines.hpp>
+#include <mat_simd.hpp>
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <vector>
 #include <assert.h>
 
@@ -14,6 +17,24 @@ struct polynomial;
 template<class T, int R, int C>
 struct mat;
 
+template<class T, int N>
+struct lu_factorization;
+
+namespace detail
+{
+
+// what partial pivoting compares, exact types only need a non zero pivot
+template<class T>
+constexpr auto pivot_magnitude(T const& x)
+{
+    if constexpr (std::is_arithmetic_v<T>)
+        return abs(x);
+    else
+        return x == T(0) ? 0 : 1;
+}
+
+}
+
 template<class T, int N>
 using col_vec = mat<T, N, 1>;
 
@@ -30,7 +51,7 @@ template<class T, int R, int C>
 using mat_t = std::conditional_t<1 == R && 1 == C, T, mat<T, R, C>>;
 
 template<class T, int R, int C>
-struct mat
+struct alignas(detail::mat_alignment<T, R, C>::value) mat
 {
     ER_STATIC_CONSTEXPR bool is_scalar = 1 == R && 1 == C;
     ER_STATIC_CONSTEXPR bool is_vector = !is_scalar && (1 == R || 1 == C);
@@ -41,8 +62,8 @@ struct mat
 
     using Row_t = row_vec_t<T, C>;
     using Col_t = col_vec_t<T, R>;
-    using Data_t = std::conditional_t<1 == C && 1 == R, T, std::conditional_t<1 == R, Col_t[C], Row_t[R]>>;
     using Data_t = std::conditional_t<1 != R, Row_t[R], std::conditional_t<1 != C, Col_t[C], T>>;
+    using kernel = detail::mat_kernel<T, R, C>;
 
     union
     {
@@ -50,11 +71,12 @@ struct mat
         T raw_data[R][C];
     };
 
-    mat() : data{} {}
+    // constructors set data, the member the constant evaluated code reads, raw_data is for the kernels
+    constexpr mat() : data{} {}
 
     mat(mat const&) = default;
 
-    static mat identity() requires (is_square)
+    static constexpr mat identity() requires (is_square)
     {
         mat result;
         for (int i = 0; i < R; ++i)
@@ -62,35 +84,51 @@ struct mat
         return result;
     }
 
-    mat(T const& arg) requires (is_scalar) : data{ arg } {}
+    constexpr mat(T const& arg) requires (is_scalar) : data{ arg } {}
     template<std::convertible_to<T>...Args> requires (is_vector && (sizeof...(Args) == vector_dim))
-    mat(Args const&...args) : data{ T(args)...} {}
+    constexpr mat(Args const&...args) : data{ T(args)...} {}
 
     
     template<class...Args> requires (is_matrix && (sizeof...(Args) == R*C) && (std::convertible_to<T, Args> && ...))
-    mat(Args const&...args) : raw_data{ T(args)... }
+    constexpr mat(Args const&...args) : data{}
     {
+        const T values[] = { T(args)... };
+        for (int i = 0; i < R; ++i)
+            for (int j = 0; j < C; ++j)
+                data[i][j] = values[i * C + j];
     }
 
     template<class...Args> requires (is_matrix && (sizeof...(Args) == R) && (std::convertible_to<Row_t, Args> && ...))
-    mat(Args const&...args) : data{Row_t(args)...} {}
+    constexpr mat(Args const&...args) : data{Row_t(args)...} {}
 
     template<class...Args> requires (is_matrix && (sizeof...(Args) == C) && (std::convertible_to<Col_t, Args> && ...))
-    mat(Args const&...args) : mat(transpose(mat<T, C, R>(transpose(args)...))) {}
+    constexpr mat(Args const&...args) : mat(transpose(mat<T, C, R>(transpose(args)...))) {}
 
-    operator T const&() const requires (is_scalar) { return data; }
-    operator T&() requires (is_scalar) { return data; }
+    constexpr operator T const&() const requires (is_scalar) { return data; }
+    constexpr operator T&() requires (is_scalar) { return data; }
 
-    friend mat<T, C, R> transpose(mat const& m)
+    // row major elements for the kernels, not usable in constant expressions
+    T* ptr() { return raw_data[0]; }
+    T const* ptr() const { return raw_data[0]; }
+
+    friend constexpr mat<T, C, R> transpose(mat const& m)
     {
         mat<T, C, R> result;
+        if constexpr (requires(T* p) { kernel::transpose(p, p); })
+        {
+            if (!std::is_constant_evaluated())
+            {
+                kernel::transpose(result.ptr(), m.ptr());
+                return result;
+            }
+        }
         for (int r = 0; r < R; ++r)
             for (int c = 0; c < C; ++c)
                 result(c, r) = m(r, c);
         return result;
 	}
 
-    auto& at(int i, int j)
+    constexpr auto& at(int i, int j)
     {
         if constexpr (is_scalar)
         {
@@ -106,19 +144,27 @@ struct mat
             return data[i][j];
     }
 
-    auto& operator()(int i, int j) { return at(i, j); }
-    auto const& operator()(int i, int j) const { return const_cast<mat*>(this)->at(i, j); }
+    constexpr auto& operator()(int i, int j) { return at(i, j); }
+    constexpr auto const& operator()(int i, int j) const { return const_cast<mat*>(this)->at(i, j); }
 
-    auto& operator[](int i) requires( !is_scalar ){ assert(i < array_sz); return data[i]; }
-    auto const& operator[](int i) const requires(!is_scalar) { assert(i < array_sz); return data[i]; }
+    constexpr auto& operator[](int i) requires( !is_scalar ){ assert(i < array_sz); return data[i]; }
+    constexpr auto const& operator[](int i) const requires(!is_scalar) { assert(i < array_sz); return data[i]; }
 
-    auto& operator[](int i) requires(is_scalar) { assert(i == 0); return data; }
-    auto const& operator[](int i) const requires(is_scalar) { assert(i == 0); return data; }
+    constexpr auto& operator[](int i) requires(is_scalar) { assert(i == 0); return data; }
+    constexpr auto const& operator[](int i) const requires(is_scalar) { assert(i == 0); return data; }
 
     template<int M>
-    friend mat_t<T, R, M> operator*(mat const& x, mat<T, C, M> const& y)
+    friend constexpr mat_t<T, R, M> operator*(mat const& x, mat<T, C, M> const& y)
     {
         mat<T, R, M> result;
+        if constexpr (C == M && requires(T* p) { kernel::mul(p, p, p); })
+        {
+            if (!std::is_constant_evaluated())
+            {
+                kernel::mul(result.ptr(), x.ptr(), y.ptr());
+                return result;
+            }
+        }
         for (int r = 0; r < R; ++r)
             for (int c = 0; c < M; ++c)
                 for (int n = 0; n < C; ++n)
@@ -127,7 +173,7 @@ struct mat
     }
 
     template<auto F> requires(!std::is_same_v<std::invoke_result_t<decltype(F), T>, void>)
-    friend auto transform(mat const& x)
+    friend constexpr auto transform(mat const& x)
     {
         mat<std::invoke_result_t<decltype(F), T>, R, C> result;
         for (int i = 0; i < R; ++i)
@@ -136,10 +182,22 @@ struct mat
         return result;
     }
 
+    // whether the element wise F runs on the kernel's lanes
+    template<auto F>
+    ER_STATIC_CONSTEXPR bool has_lanes = requires { typename kernel::lanes; } && detail::lane_op::none != detail::lane_op_of<T, F>();
+
     template<auto F> requires(!std::is_same_v<std::invoke_result_t<decltype(F), T, T>, void>)
-    friend auto element_wise(mat const& x, T const& y)
+    friend constexpr auto element_wise(mat const& x, T const& y)
     {
         mat<std::invoke_result_t<decltype(F), T, T>, R, C> result;
+        if constexpr (has_lanes<F>)
+        {
+            if (!std::is_constant_evaluated())
+            {
+                detail::lanes_element_wise<typename kernel::lanes, detail::lane_op_of<T, F>(), R * C>(result.ptr(), x.ptr(), y);
+                return result;
+            }
+        }
         for (int i = 0; i < R; ++i)
             for (int j = 0; j < C; ++j)
                 result(i, j) = F(x(i, j), y);
@@ -147,9 +205,17 @@ struct mat
     }
 
     template<auto F> requires(!std::is_same_v<std::invoke_result_t<decltype(F), T, T>, void>)
-    friend auto element_wise(T const& x, mat const& y)
+    friend constexpr auto element_wise(T const& x, mat const& y)
     {
         mat<std::invoke_result_t<decltype(F), T, T>, R, C> result;
+        if constexpr (has_lanes<F>)
+        {
+            if (!std::is_constant_evaluated())
+            {
+                detail::lanes_element_wise<typename kernel::lanes, detail::lane_op_of<T, F>(), R * C>(result.ptr(), x, y.ptr());
+                return result;
+            }
+        }
         for (int i = 0; i < R; ++i)
             for (int j = 0; j < C; ++j)
                 result(i, j) = F(x, y(i, j));
@@ -157,30 +223,68 @@ struct mat
     }
 
     template<auto F> requires(!std::is_same_v<std::invoke_result_t<decltype(F), T, T>, void>)
-    friend auto element_wise(mat const& x, mat const& y)
+    friend constexpr auto element_wise(mat const& x, mat const& y)
     {
         mat<std::invoke_result_t<decltype(F), T, T>, R, C> result;
+        if constexpr (has_lanes<F>)
+        {
+            if (!std::is_constant_evaluated())
+            {
+                detail::lanes_element_wise<typename kernel::lanes, detail::lane_op_of<T, F>(), R * C>(result.ptr(), x.ptr(), y.ptr());
+                return result;
+            }
+        }
         for (int i = 0; i < R; ++i)
             for (int j = 0; j < C; ++j)
                 result(i, j) = F(x(i, j), y(i, j));
         return result;
     }
 
-    friend mat operator+(mat const& x, mat const& y) { return element_wise<add<T>>(x, y); }
-    friend mat operator-(mat const& x, mat const& y) { return element_wise<sub<T>>(x, y); }
-    friend mat operator*(mat const& x, T const& y) { return element_wise<mul<T>>(x, y); }
-    friend mat operator*(T const& x, mat const& y) { return element_wise<mul<T>>(x, y); }
-    friend mat operator/(mat const& x, T const& y) { return element_wise<div<T>>(x, y); }
+    friend constexpr mat operator+(mat const& x, mat const& y) { return element_wise<add<T>>(x, y); }
+    friend constexpr mat operator-(mat const& x, mat const& y) { return element_wise<sub<T>>(x, y); }
+    friend constexpr mat operator*(mat const& x, T const& y) { return element_wise<mul<T>>(x, y); }
+    friend constexpr mat operator*(T const& x, mat const& y) { return element_wise<mul<T>>(x, y); }
+    friend constexpr mat operator/(mat const& x, T const& y) { return element_wise<div<T>>(x, y); }
 
-    friend mat& operator+=(mat& x, mat const& y) { return x = element_wise<add<T>>(x, y); }
-    friend mat& operator-=(mat& x, mat const& y) { return x = element_wise<sub<T>>(x, y); }
-    friend mat& operator*=(mat& x, T const& y) { return x = element_wise<mul<T>>(x, y); }
-    friend mat& operator/=(mat& x, T const& y) { return x = element_wise<div<T>>(x, y); }
+    friend constexpr mat& operator+=(mat& x, mat const& y) { return in_place<add<T>>(x, y); }
+    friend constexpr mat& operator-=(mat& x, mat const& y) { return in_place<sub<T>>(x, y); }
+    friend constexpr mat& operator*=(mat& x, T const& y) { return in_place<mul<T>>(x, y); }
+    friend constexpr mat& operator/=(mat& x, T const& y) { return in_place<div<T>>(x, y); }
+
+    // x = F(x, y) with no copy of x, the kernel lanes read an element before they write it
+    template<auto F, class Y>
+    static constexpr mat& in_place(mat& x, Y const& y)
+    {
+        constexpr bool is_mat = std::is_same_v<Y, mat>;
+        if constexpr (has_lanes<F>)
+        {
+            if (!std::is_constant_evaluated())
+            {
+                T const* in = x.ptr();
+                if constexpr (is_mat)
+                    detail::lanes_element_wise<typename kernel::lanes, detail::lane_op_of<T, F>(), R * C>(x.ptr(), in, y.ptr());
+                else
+                    detail::lanes_element_wise<typename kernel::lanes, detail::lane_op_of<T, F>(), R * C>(x.ptr(), in, y);
+                return x;
+            }
+        }
+        for (int i = 0; i < R; ++i)
+        {
+            for (int j = 0; j < C; ++j)
+            {
+                if constexpr (is_mat)
+                    x(i, j) = F(x(i, j), y(i, j));
+                else
+                    x(i, j) = F(x(i, j), y);
+            }
+        }
+        return x;
+    }
 
-    friend mat comp_mul(mat const& x, mat const& y) { return element_wise<mul<T>>(x, y); }
-    friend mat comp_div(mat const& x, mat const& y) { return element_wise<div<T>>(x, y); }
+    friend constexpr mat comp_mul(mat const& x, mat const& y) { return element_wise<mul<T>>(x, y); }
+    friend constexpr mat comp_div(mat const& x, mat const& y) { return element_wise<div<T>>(x, y); }
 
-    friend row_vec<T, min_v<R, C>> trace(mat const& m)
+    friend constexpr row_vec<T, min_v<R, C>> trace(mat const& m)
     {
         row_vec<T, min_v<R, C>> result;
         for (int i = 0; i < min_v<R, C>; ++i)
@@ -188,7 +292,7 @@ struct mat
         return result;
     }
 
-    friend T fold_mul(mat const& x)
+    friend constexpr T fold_mul(mat const& x)
     {
         if constexpr (is_scalar)
         {
@@ -207,7 +311,7 @@ struct mat
 		}
     }
 
-    friend T fold_add(mat const& x)
+    friend constexpr T fold_add(mat const& x)
     {
         if constexpr (is_scalar)
         {
@@ -226,7 +330,7 @@ struct mat
         }
     }
 
-    mat operator-() const { return transform<neg<T>>(*this); }
+    constexpr mat operator-() const { return transform<neg<T>>(*this); }
 
     friend std::ostream& operator<<(std::ostream& os, mat const& m)
     {
@@ -250,7 +354,7 @@ struct mat
 	}
 
     template<int C2>
-    friend mat<T, R, C + C2> operator,(mat const& x, mat<T, R, C2> const& y)
+    friend constexpr mat<T, R, C + C2> operator,(mat const& x, mat<T, R, C2> const& y)
     {
         mat<T, R, C + C2> result;
         for (int i = 0; i < R; ++i)
@@ -264,7 +368,7 @@ struct mat
     }
 
     template<int R2, int C2>
-    friend mat<T, R2, C2> slice(mat const& m, int i, int j)
+    friend constexpr mat<T, R2, C2> slice(mat const& m, int i, int j)
     {
         mat<T, R2, C2> result;
         for (int r = 0; r < R2; ++r)
@@ -273,7 +377,7 @@ struct mat
 		return result;
 	}
 
-    friend mat<T, R-1,C-1> sub_matrix(mat const& m, int i, int j) requires (is_scalar || is_square)
+    friend constexpr mat<T, R-1,C-1> sub_matrix(mat const& m, int i, int j) requires (is_scalar || is_square)
     {
         mat<T, R-1, C-1> result;
         for (int r = 0; r < R; ++r)
@@ -291,12 +395,13 @@ struct mat
 	}
 
 
-    friend void LU_decomposition(mat const& m, mat& L, mat& U) requires (is_square)
+    friend constexpr void LU_decomposition(mat const& m, mat& L, mat& U) requires (is_square)
     {
         // calculate decomposition
         // L is lower triangular
         // U is upper triangular
         // m = L*U
+        // no pivoting, so this fails on a zero leading minor, lu_factorization pivots
 
         U = m;
         L = identity();
@@ -310,8 +415,13 @@ struct mat
         }
 	}
 
-    friend T determinant(mat const& m) requires (is_scalar || is_square)
+    friend constexpr T determinant(mat const& m) requires (is_scalar || is_square)
     {
+        if constexpr (requires(T const* p) { kernel::determinant(p); })
+        {
+            if (!std::is_constant_evaluated())
+                return kernel::determinant(m.ptr());
+        }
         if constexpr (1 == R)
             return m(0, 0);
         else if constexpr(2 == R)
@@ -323,60 +433,55 @@ struct mat
             return m(0, 0) * m(1, 1) * m(2, 2) + m(0, 1) * m(1, 2) * m(2, 0) + m(0, 2) * m(1, 0) * m(2, 1)
                 - m(0, 2) * m(1, 1) * m(2, 0) - m(0, 0) * m(1, 2) * m(2, 1) - m(0, 1) * m(1, 0) * m(2, 2);
         }
-        else {
-            mat L, U;
-            LU_decomposition(m, L, U);
-            return fold_mul(comp_mul(trace(L), trace(U)));
+        else if constexpr (std::is_integral_v<T>)
+        {
+            // integral T cannot go through lu, bareiss elimination divides only exactly and stays O(R^3)
+            mat a = m;
+            T sign = T(1), previous = T(1);
+            for (int k = 0; k + 1 < R; ++k)
+            {
+                if (a(k, k) == T(0))
+                {
+                    int p = k + 1;
+                    while (p < R && a(p, k) == T(0))
+                        ++p;
+                    if (p == R)
+                        return T(0);
+                    for (int j = k; j < R; ++j)
+                        std::swap(a(k, j), a(p, j));
+                    sign = -sign;
+                }
+                for (int i = k + 1; i < R; ++i)
+                    for (int j = k + 1; j < R; ++j)
+                        a(i, j) = (a(i, j) * a(k, k) - a(i, k) * a(k, j)) / previous;
+                previous = a(k, k);
+            }
+            return sign * a(R - 1, R - 1);
         }
+        else
+            return lu_factorization<T, R>(m).determinant();
     }
 
-    friend mat inverse(mat const& m) requires (is_scalar)
-    {
-        return T(1) / m;
-    }
-
-    friend mat inverse(mat m) requires (is_square)
+    friend constexpr mat inverse(mat const& m) requires (is_scalar || is_square)
     {
-        mat augmented = identity();
-
-        for (int i = 0; i < R; ++i)
+        if constexpr (is_scalar)
+            return T(1) / m;
+        else
         {
-            int pivot = i;
-            for (int j = i + 1; j < R; ++j)
-                if (std::abs(m(j, i)) > std::abs(m(pivot, i)))
-                    pivot = j;
-            if (pivot != i)
-            {
-                std::swap(m[i], m[pivot]);
-                std::swap(augmented[i], augmented[pivot]);
-            }
-
-            T pivot_value = m(i, i);
-            if (pivot_value == T(0))
-                return {};
-
-            for (int j = 0; j < C; ++j)
-            {
-                m(i, j) /= pivot_value;
-                augmented(i, j) /= pivot_value;
-            }
-            for (int j = 0; j < R; ++j)
+            if constexpr (requires(T* p) { kernel::inverse(p, p); })
             {
-                if (j == i)
-                    continue;
-                T factor = m(j, i);
-                for (int k = 0; k < C; ++k)
+                if (!std::is_constant_evaluated())
                 {
-                    m(j, k) -= factor * m(i, k);
-                    augmented(j, k) -= factor * augmented(i, k);
+                    mat result;
+                    return kernel::inverse(result.ptr(), m.ptr()) ? result : mat{};
                 }
             }
+            return lu_factorization<T, R>(m).inverse();
         }
-        return augmented;
     }
 
     template<int K>
-    friend mat<T, K, K> minor(mat const& m, row_vec<int, K> const& select) requires(is_square)
+    friend constexpr mat<T, K, K> minor(mat const& m, row_vec<int, K> const& select) requires(is_square)
     {
         mat<T, K, K> result;
         for (int i = 0; i < K; ++i)
@@ -385,68 +490,212 @@ struct mat
         return result;
     }
 
-    template<int I, int S = 0> requires (I >= 0 && S >= 0 && S + I <= R)
-    static T sum_of_determinants_of_principal_minors_permute(mat const& m, auto& c) requires(is_square)
+    // similar upper hessenberg matrix by gaussian elimination with row and column pivoting,
+    // needs no square roots so exact types stay exact
+    friend constexpr mat hessenberg(mat h) requires(is_square)
     {
-        if constexpr (I == 0)
+        for (int k = 1; k + 1 < R; ++k)
         {
-            return determinant(minor(m, c));
+            int pivot = k;
+            for (int i = k + 1; i < R; ++i)
+                if (detail::pivot_magnitude(h(i, k - 1)) > detail::pivot_magnitude(h(pivot, k - 1)))
+                    pivot = i;
+            if (h(pivot, k - 1) == T(0))
+                continue;
+            if (pivot != k)
+            {
+                for (int j = 0; j < R; ++j)
+                    std::swap(h(pivot, j), h(k, j));
+                for (int i = 0; i < R; ++i)
+                    std::swap(h(i, pivot), h(i, k));
+            }
+            for (int i = k + 1; i < R; ++i)
+            {
+                const T y = h(i, k - 1) / h(k, k - 1);
+                if (y == T(0))
+                    continue;
+                for (int j = k - 1; j < R; ++j)
+                    h(i, j) -= y * h(k, j);
+                for (int j = 0; j < R; ++j)
+                    h(j, k) += y * h(j, i);
+            }
         }
-        else if constexpr (S == R)
+        return h;
+    }
+
+    // det(x I - m) in O(R^3), coefficient i belongs to x^i
+    // over the leading k x k blocks of the hessenberg form h the characteristic polynomials satisfy
+    // p_k = (x - h_kk) p_k-1 - sum_i<k h_ik h_i+1,i ... h_k,k-1 p_i-1
+    // integral T cannot divide, it takes the division free berkowitz algorithm in O(R^4) instead
+    friend constexpr polynomial<T, R> characteristic_polynomial(mat const& m) requires(is_square)
+    {
+        row_vec<T, R + 1> result;
+        if constexpr (std::is_integral_v<T>)
         {
-            abort();
-            return T(0);
+            // p[j] is the coefficient of x^(k - j) for the leading k x k block,
+            // the next block's is the lower triangular toeplitz matrix of q times p
+            T p[R + 1] = { T(1) }, q[R + 1], v[R], w[R];
+            for (int k = 0; k < R; ++k)
+            {
+                q[0] = T(1);
+                q[1] = -m(k, k);
+                for (int i = 0; i < k; ++i)
+                    v[i] = m(i, k);
+                for (int j = 2; j <= k + 1; ++j)
+                {
+                    T s = T(0);
+                    for (int i = 0; i < k; ++i)
+                        s += m(k, i) * v[i];
+                    q[j] = -s;
+                    for (int i = 0; i < k; ++i)
+                    {
+                        w[i] = T(0);
+                        for (int l = 0; l < k; ++l)
+                            w[i] += m(i, l) * v[l];
+                    }
+                    std::copy(w, w + k, v);
+                }
+                for (int i = k + 1; i >= 0; --i)
+                {
+                    T s = T(0);
+                    for (int j = std::max(0, i - k); j <= i; ++j)
+                        s += q[j] * p[i - j];
+                    p[i] = s;
+                }
+            }
+            for (int i = 0; i <= R; ++i)
+                result[i] = p[R - i];
         }
         else
         {
-            c[I - 1] = S;
-            T result = sum_of_determinants_of_principal_minors_permute<I - 1, S + 1>(m, c);
-            if constexpr (S + I < R)
-                result += sum_of_determinants_of_principal_minors_permute<I, S + 1>(m, c);
-            return result;
+            const mat h = hessenberg(m);
+            T p[R + 1][R + 1] = {};
+            p[0][0] = T(1);
+            for (int k = 1; k <= R; ++k)
+            {
+                const int kk = k - 1;
+                for (int i = 0; i < k; ++i)
+                {
+                    p[k][i + 1] += p[kk][i];
+                    p[k][i] -= h(kk, kk) * p[kk][i];
+                }
+                T prod = T(1);
+                for (int i = kk - 1; i >= 0; --i)
+                {
+                    prod *= h(i + 1, i);
+                    const T f = h(i, kk) * prod;
+                    for (int j = 0; j <= i; ++j)
+                        p[k][j] -= f * p[i][j];
+                }
+            }
+            for (int i = 0; i <= R; ++i)
+                result[i] = p[R][i];
         }
+        return polynomial<T, R>(result);
     }
 
-    template<int K>
-    friend T sum_of_determinants_of_principal_minors(mat const& m) requires(is_square)
+    template<int N>
+    friend constexpr mat<T, R, C+N> left_fill(mat const& m) requires(is_matrix)
     {
-        if constexpr (R == K)
-            return determinant(m);
-        else if constexpr (0 == K)
-            return T(1);
-        else
-        {
-            row_vec<int, K> select;
-            return sum_of_determinants_of_principal_minors_permute<K>(m, select);
-        }
+        return (mat<T, R, N>(), m);
     }
 
     template<int N>
-    friend void collect_sum_of_determinants_of_principal_minors(mat const& m, row_vec<T, R + 1>& out) requires(is_square)
+    friend constexpr mat<T, R, C+N> right_fill(mat const& m) requires(is_matrix)
     {
-        assert(N >= 0 && N <= R);
-        out[N] = ((R+N)&1?-1:1)*sum_of_determinants_of_principal_minors<R-N>(m);
-        if constexpr (N > 0)
-            collect_sum_of_determinants_of_principal_minors<N - 1>(m, out);
-	}
+        return (m, mat<T, R, N>());
+    }
+};
 
-    friend polynomial<T, R> characteristic_polynomial(mat const& m) requires(is_square)
+// p m = l u with partial pivoting, factored once for any number of solves
+// lu holds the unit lower l below its diagonal and u on and above it, row i of lu comes from row perm[i] of m
+// a zero pivot marks the factorization singular, solve and inverse return {} then
+template<class T, int N>
+struct lu_factorization
+{
+    mat<T, N, N> lu;
+    std::array<int, N> perm;
+    bool odd = false;
+    bool singular = false;
+
+    constexpr explicit lu_factorization(mat<T, N, N> const& m) : lu(m)
     {
-		row_vec<T, R+1> result;
-        collect_sum_of_determinants_of_principal_minors<R>(m, result);
-		return polynomial<T, R>(result);
-	}
+        for (int i = 0; i < N; ++i)
+            perm[i] = i;
 
-    template<int N>
-    friend mat<T, R, C+N> left_fill(mat const& m) requires(is_matrix)
+        for (int j = 0; j < N; ++j)
+        {
+            int pivot = j;
+            for (int i = j + 1; i < N; ++i)
+                if (detail::pivot_magnitude(lu(i, j)) > detail::pivot_magnitude(lu(pivot, j)))
+                    pivot = i;
+            if (lu(pivot, j) == T(0))
+            {
+                singular = true;
+                continue;
+            }
+            if (pivot != j)
+            {
+                for (int k = 0; k < N; ++k)
+                    std::swap(lu(j, k), lu(pivot, k));
+                std::swap(perm[j], perm[pivot]);
+                odd = !odd;
+            }
+            for (int i = j + 1; i < N; ++i)
+            {
+                lu(i, j) /= lu(j, j);
+                for (int k = j + 1; k < N; ++k)
+                    lu(i, k) -= lu(i, j) * lu(j, k);
+            }
+        }
+    }
+
+    // x with m x = b for every column of b, O(N^2) per column
+    template<int M>
+    constexpr mat<T, N, M> solve(mat<T, N, M> const& b) const
     {
-        return (mat<T, R, N>(), m);
+        if (singular)
+            return {};
+        mat<T, N, M> x;
+        for (int i = 0; i < N; ++i)
+        {
+            for (int c = 0; c < M; ++c)
+            {
+                T s = b(perm[i], c);
+                for (int k = 0; k < i; ++k)
+                    s -= lu(i, k) * x(k, c);
+                x(i, c) = s;
+            }
+        }
+        for (int i = N - 1; i >= 0; --i)
+        {
+            for (int c = 0; c < M; ++c)
+            {
+                T s = x(i, c);
+                for (int k = i + 1; k < N; ++k)
+                    s -= lu(i, k) * x(k, c);
+                x(i, c) = s / lu(i, i);
+            }
+        }
+        return x;
     }
 
-    template<int N>
-    friend mat<T, R, C+N> right_fill(mat const& m) requires(is_matrix)
+    constexpr T determinant() const
     {
-        return (m, mat<T, R, N>());
+        if (singular)
+            return T(0);
+        T det = lu(0, 0);
+        for (int i = 1; i < N; ++i)
+            det *= lu(i, i);
+        return odd ? -det : det;
+    }
+
+    constexpr mat<T, N, N> inverse() const
+    {
+        mat<T, N, N> id;
+        for (int i = 0; i < N; ++i)
+            id(i, i) = T(1);
+        return solve(id);
     }
 };
 
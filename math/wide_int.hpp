@@ -0,0 +1,404 @@
+#pragma once
+
+#include <num.hpp>
+#include <utility>
+
+namespace er
+{
+
+// fixed width integer of Bits bits on the stack, two's complement when Signed
+// arithmetic wraps modulo 2^Bits like the builtin unsigned types, division truncates like num
+template<size_t Bits, bool Signed = false>
+struct wide_int
+{
+    static_assert(Bits >= 64 && 0 == Bits % 64, "wide_int works on whole 64 bit words");
+
+    ER_STATIC_CONSTEXPR size_t words = Bits / 64;
+
+    // little endian
+    u64 w[words] = {};
+
+    constexpr wide_int() = default;
+
+    template<class T> requires(std::is_integral_v<T>)
+    constexpr wide_int(T v)
+    {
+        const u64 ext = v < 0 ? ~u64(0) : 0;
+        for (size_t i = 0; i < words; ++i)
+            w[i] = ext;
+        w[0] = u64(v);
+        if constexpr (sizeof(T) > 8 && words > 1)
+            w[1] = u64(v >> 64);
+    }
+
+    // truncates, or extends with the sign of o
+    template<size_t B, bool S>
+    constexpr explicit wide_int(wide_int<B, S> const& o)
+    {
+        const u64 ext = o.negative() ? ~u64(0) : 0;
+        for (size_t i = 0; i < words; ++i)
+            w[i] = i < o.words ? o.w[i] : ext;
+    }
+
+    // n mod 2^Bits
+    explicit wide_int(num const& n)
+    {
+        for (size_t i = 0; i < words; ++i)
+        {
+            if constexpr (64 == num::bits)
+                w[i] = n.get(i);
+            else
+                w[i] = u64(n.get(2 * i)) | (u64(n.get(2 * i + 1)) << 32);
+        }
+    }
+
+    explicit operator num() const
+    {
+        num res;
+        res.extension = negative() ? num::mask : 0;
+        res.data.resize(Bits / num::bits);
+        for (size_t i = 0; i < res.data.size(); ++i)
+            res.data[i] = digit(w[i * num::bits / 64] >> (i * num::bits % 64));
+        res.canonicalize();
+        return res;
+    }
+
+    template<class T> requires(std::is_integral_v<T>)
+    constexpr explicit operator T() const
+    {
+        if constexpr (sizeof(T) > 8 && words > 1)
+            return T((T(w[1]) << 64) | w[0]);
+        else
+            return T(w[0]);
+    }
+
+    constexpr explicit operator bool() const
+    {
+        for (size_t i = 0; i < words; ++i)
+            if (w[i])
+                return true;
+        return false;
+    }
+
+    constexpr bool negative() const
+    {
+        return Signed && (w[words - 1] >> 63);
+    }
+
+    // a + b + c, c is the carry in and out
+    static constexpr u64 adc(u64 a, u64 b, u64& c)
+    {
+        const u64 s = a + b;
+        const u64 r = s + c;
+        c = u64(s < a) | u64(r < s);
+        return r;
+    }
+
+    // a - b - c, c is the borrow in and out
+    static constexpr u64 sbb(u64 a, u64 b, u64& c)
+    {
+        const u64 d = a - b;
+        const u64 r = d - c;
+        c = u64(a < b) | u64(d < c);
+        return r;
+    }
+
+    // a * b, returns the low word and stores the high one in hi
+    static constexpr u64 mul_wide(u64 a, u64 b, u64& hi)
+    {
+#if defined(__SIZEOF_INT128__)
+        const unsigned __int128 p = (unsigned __int128)a * b;
+        hi = u64(p >> 64);
+        return u64(p);
+#else
+        const u64 a0 = a & 0xffffffff, a1 = a >> 32;
+        const u64 b0 = b & 0xffffffff, b1 = b >> 32;
+        const u64 p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+        const u64 mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+        hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+        return (mid << 32) | (p00 & 0xffffffff);
+#endif
+    }
+
+    // f(0), ..., f(words - 1) without a loop
+    template<class F>
+    static constexpr void unrolled(F&& f)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>) { (f(I), ...); }(std::make_index_sequence<words>());
+    }
+
+    friend constexpr wide_int operator +(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        u64 carry = 0;
+        unrolled([&](size_t i) { res.w[i] = adc(l.w[i], r.w[i], carry); });
+        return res;
+    }
+
+    friend constexpr wide_int operator -(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        u64 borrow = 0;
+        unrolled([&](size_t i) { res.w[i] = sbb(l.w[i], r.w[i], borrow); });
+        return res;
+    }
+
+    friend constexpr wide_int operator ~(wide_int const& n)
+    {
+        wide_int res;
+        unrolled([&](size_t i) { res.w[i] = ~n.w[i]; });
+        return res;
+    }
+
+    friend constexpr wide_int operator -(wide_int const& n)
+    {
+        return wide_int() - n;
+    }
+
+    // the low Bits of the product, the same for both signs in two's complement
+    friend constexpr wide_int operator *(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        for (size_t i = 0; i < words; ++i)
+        {
+            u64 carry = 0;
+            for (size_t j = 0; i + j < words; ++j)
+            {
+                u64 hi = 0, c0 = 0, c1 = 0;
+                const u64 lo = adc(mul_wide(l.w[i], r.w[j], hi), carry, c0);
+                res.w[i + j] = adc(res.w[i + j], lo, c1);
+                carry = hi + c0 + c1;
+            }
+        }
+        return res;
+    }
+
+    // q = a / b, r = a % b on the unsigned values
+    // Knuth, TAOCP vol. 2, 4.3.1 algorithm D on 32 bit halves so it stays constexpr without a 128 bit type
+    static constexpr void divmod_unsigned(wide_int const& a, wide_int const& b, wide_int& q, wide_int& r)
+    {
+        constexpr size_t h = 2 * words;
+        u32 u[h + 1] = {}, v[h] = {}, qs[h] = {};
+        for (size_t i = 0; i < words; ++i)
+        {
+            u[2 * i] = u32(a.w[i]);
+            u[2 * i + 1] = u32(a.w[i] >> 32);
+            v[2 * i] = u32(b.w[i]);
+            v[2 * i + 1] = u32(b.w[i] >> 32);
+        }
+
+        size_t m = h, n = h;
+        while (m && !u[m - 1])
+            --m;
+        while (n && !v[n - 1])
+            --n;
+        assert(n && "division by zero");
+
+        q = wide_int();
+        r = wide_int();
+        if (m < n)
+        {
+            r = a;
+            return;
+        }
+
+        auto store = [](u32 const* p, size_t len, wide_int& res)
+        {
+            for (size_t i = 0; i < len; ++i)
+                res.w[i / 2] |= u64(p[i]) << (i % 2 * 32);
+        };
+
+        if (1 == n)
+        {
+            u64 rem = 0;
+            for (size_t i = m; i--;)
+            {
+                const u64 cur = (rem << 32) | u[i];
+                qs[i] = u32(cur / v[0]);
+                rem = cur % v[0];
+            }
+            store(qs, m, q);
+            r.w[0] = rem;
+            return;
+        }
+
+        // normalize so the top divisor half has its high bit set
+        const int s = std::countl_zero(v[n - 1]);
+        if (s)
+        {
+            for (size_t i = n - 1; i > 0; --i)
+                v[i] = (v[i] << s) | (v[i - 1] >> (32 - s));
+            v[0] <<= s;
+            u[m] = u[m - 1] >> (32 - s);
+            for (size_t i = m - 1; i > 0; --i)
+                u[i] = (u[i] << s) | (u[i - 1] >> (32 - s));
+            u[0] <<= s;
+        }
+
+        for (size_t j = m - n + 1; j--;)
+        {
+            const u64 top = (u64(u[j + n]) << 32) | u[j + n - 1];
+            u64 qhat = top / v[n - 1];
+            u64 rhat = top % v[n - 1];
+            while (qhat >> 32 || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2]))
+            {
+                --qhat;
+                rhat += v[n - 1];
+                if (rhat >> 32)
+                    break;
+            }
+
+            i64 borrow = 0, t = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const u64 p = qhat * v[i];
+                t = i64(u[i + j]) - borrow - i64(p & 0xffffffff);
+                u[i + j] = u32(t);
+                borrow = i64(p >> 32) - (t >> 32);
+            }
+            t = i64(u[j + n]) - borrow;
+            u[j + n] = u32(t);
+
+            qs[j] = u32(qhat);
+            if (t < 0)
+            {
+                // qhat was one too large, add the divisor back
+                --qs[j];
+                u64 carry = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const u64 sum = u64(u[i + j]) + v[i] + carry;
+                    u[i + j] = u32(sum);
+                    carry = sum >> 32;
+                }
+                u[j + n] = u32(u[j + n] + carry);
+            }
+        }
+        store(qs, m - n + 1, q);
+
+        if (s)
+            for (size_t i = 0; i < n; ++i)
+                u[i] = (u[i] >> s) | (u[i + 1] << (32 - s));
+        store(u, n, r);
+    }
+
+    // truncating division, the remainder takes the sign of the dividend
+    friend constexpr wide_int divmod(wide_int const& a, wide_int const& b, wide_int& r)
+    {
+        wide_int q;
+        divmod_unsigned(a.negative() ? -a : a, b.negative() ? -b : b, q, r);
+        if (a.negative())
+            r = -r;
+        return a.negative() != b.negative() ? -q : q;
+    }
+
+    friend constexpr wide_int operator /(wide_int const& a, wide_int const& b)
+    {
+        wide_int r;
+        return divmod(a, b, r);
+    }
+
+    friend constexpr wide_int operator %(wide_int const& a, wide_int const& b)
+    {
+        wide_int r;
+        divmod(a, b, r);
+        return r;
+    }
+
+    friend constexpr wide_int operator &(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        unrolled([&](size_t i) { res.w[i] = l.w[i] & r.w[i]; });
+        return res;
+    }
+
+    friend constexpr wide_int operator |(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        unrolled([&](size_t i) { res.w[i] = l.w[i] | r.w[i]; });
+        return res;
+    }
+
+    friend constexpr wide_int operator ^(wide_int const& l, wide_int const& r)
+    {
+        wide_int res;
+        unrolled([&](size_t i) { res.w[i] = l.w[i] ^ r.w[i]; });
+        return res;
+    }
+
+    friend constexpr wide_int operator <<(wide_int const& n, size_t s)
+    {
+        wide_int res;
+        if (s >= Bits)
+            return res;
+        const size_t k = s / 64;
+        const int b = int(s % 64);
+        for (size_t i = words; i-- > k;)
+        {
+            res.w[i] = n.w[i - k] << b;
+            if (b && i > k)
+                res.w[i] |= n.w[i - k - 1] >> (64 - b);
+        }
+        return res;
+    }
+
+    // arithmetic for signed, logical for unsigned
+    friend constexpr wide_int operator >>(wide_int const& n, size_t s)
+    {
+        const u64 ext = n.negative() ? ~u64(0) : 0;
+        wide_int res;
+        for (size_t i = 0; i < words; ++i)
+            res.w[i] = ext;
+        if (s >= Bits)
+            return res;
+        const size_t k = s / 64;
+        const int b = int(s % 64);
+        for (size_t i = 0; i + k < words; ++i)
+        {
+            const u64 next = i + k + 1 < words ? n.w[i + k + 1] : ext;
+            res.w[i] = n.w[i + k] >> b;
+            if (b)
+                res.w[i] |= next << (64 - b);
+        }
+        return res;
+    }
+
+    friend constexpr wide_int& operator +=(wide_int& l, wide_int const& r) { return l = l + r; }
+    friend constexpr wide_int& operator -=(wide_int& l, wide_int const& r) { return l = l - r; }
+    friend constexpr wide_int& operator *=(wide_int& l, wide_int const& r) { return l = l * r; }
+    friend constexpr wide_int& operator /=(wide_int& l, wide_int const& r) { return l = l / r; }
+    friend constexpr wide_int& operator %=(wide_int& l, wide_int const& r) { return l = l % r; }
+    friend constexpr wide_int& operator &=(wide_int& l, wide_int const& r) { return l = l & r; }
+    friend constexpr wide_int& operator |=(wide_int& l, wide_int const& r) { return l = l | r; }
+    friend constexpr wide_int& operator ^=(wide_int& l, wide_int const& r) { return l = l ^ r; }
+    friend constexpr wide_int& operator <<=(wide_int& l, size_t s) { return l = l << s; }
+    friend constexpr wide_int& operator >>=(wide_int& l, size_t s) { return l = l >> s; }
+
+    friend constexpr bool operator ==(wide_int const& l, wide_int const& r) = default;
+
+    friend constexpr std::strong_ordering operator <=>(wide_int const& l, wide_int const& r)
+    {
+        if (l.negative() != r.negative())
+            return l.negative() ? std::strong_ordering::less : std::strong_ordering::greater;
+        for (size_t i = words; i--;)
+            if (l.w[i] != r.w[i])
+                return l.w[i] <=> r.w[i];
+        return std::strong_ordering::equal;
+    }
+
+    friend std::ostream& operator <<(std::ostream& os, wide_int const& n)
+    {
+        return os << num(n);
+    }
+};
+
+using u128 = wide_int<128>;
+using u256 = wide_int<256>;
+using u512 = wide_int<512>;
+using i128 = wide_int<128, true>;
+using i256 = wide_int<256, true>;
+using i512 = wide_int<512, true>;
+
+static_assert(std::is_trivially_copyable_v<u256>);
+
+}